@@ -47,8 +47,8 @@ int main()
     state.value = 1;
     state.intr_cntr = 0;
     state.prev_intr_cntr = 0;
-    state.uptime_timeout = std::chrono::high_resolution_clock::now();
-    state.uptime_reentry = std::chrono::high_resolution_clock::now();
+    state.uptime_timeout = MachineState::clock_type::now();
+    state.uptime_reentry = MachineState::clock_type::now();
 
     switch (state.value)
     {
@@ -0,0 +1,581 @@
+/**
+ * @file async_log.h
+ *
+ * @brief This file contains the AsyncLogger class and the LOG_* macros.
+ *
+ * A log call on the hot path only stores a timestamp, the format string
+ * pointer and the raw arguments (strings are copied inline) into a fixed-size
+ * record of the calling thread's own SpscQueue. A background thread formats
+ * the records, colourizes them when the output is a terminal and writes whole
+ * batches with one writev(), so lines never interleave and the caller never
+ * formats or blocks in a system call.
+ *
+ * The format string must be a string literal (or otherwise outlive the
+ * logger); it is checked like printf at compile time by the LOG_* macros.
+ * Levels below RD_KITS_LOG_LEVEL are stripped at compile time.
+ *
+ * @code{.cpp}
+ * #define RD_KITS_LOG_LEVEL LOG_LEVEL_INFO // LOG_DEBUG compiles to nothing
+ * #include "async_log.h"
+ *
+ * async_logger(); // at startup: starts the writer and calibrates the clock
+ * ...
+ * LOG_INFO("loop %d took %.3f ms", i, dt * 1e3);
+ * LOG_WARN("motor %s disconnected", name);
+ * LOG_COLOR(COLOR_GREEN, "ready");
+ * async_logger().flush(); // wait until everything is written
+ * @endcode
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include "custom_time.h"
+#include "spsc_queue.h"
+#include "stdout_with_colour.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+/* LEVEL DEFINITIONS */
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+/**
+ * @brief The lowest level compiled in.
+ *
+ */
+#ifndef RD_KITS_LOG_LEVEL
+#define RD_KITS_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/**
+ * @brief The size of one record, the arguments get this minus 32 bytes.
+ *
+ */
+#ifndef ASYNC_LOG_RECORD_SIZE
+#define ASYNC_LOG_RECORD_SIZE 256
+#endif
+
+/**
+ * @brief The maximum number of threads logging to one AsyncLogger.
+ *
+ */
+#ifndef ASYNC_LOG_MAX_THREADS
+#define ASYNC_LOG_MAX_THREADS 64
+#endif
+
+/**
+ * @brief The longest formatted line, longer lines are truncated.
+ *
+ */
+#ifndef ASYNC_LOG_LINE_SIZE
+#define ASYNC_LOG_LINE_SIZE 512
+#endif
+
+/**
+ * @brief What a producer does when its queue is full.
+ *
+ */
+enum AsyncLogPolicy
+{
+    ASYNC_LOG_DROP, // count the record in dropped() and return
+    ASYNC_LOG_BLOCK // yield until the writer makes room
+};
+
+typedef size_t (*async_log_render_t)(const char *format, const uint8_t *args, char *out, size_t size);
+
+/**
+ * @brief One captured log call.
+ *
+ */
+typedef struct
+{
+    uint64_t t_ns;
+    const char *format;
+    async_log_render_t render;
+    uint8_t level;
+    uint8_t color;
+    uint8_t args[ASYNC_LOG_RECORD_SIZE - 32];
+} async_log_record_t;
+
+static_assert(sizeof(async_log_record_t) == ASYNC_LOG_RECORD_SIZE, "ASYNC_LOG_RECORD_SIZE must be a multiple of 8");
+
+/**
+ * @brief How an argument is stored in a record: numbers and pointers by value.
+ *
+ */
+template <class T>
+struct AsyncLogArg
+{
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                  "log arguments must be numbers, pointers or strings");
+    typedef T stored_type;
+    static constexpr size_t reserve = sizeof(T);
+
+    static void encode(uint8_t *&p, const uint8_t *, const T &value)
+    {
+        memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+
+    static T decode(const uint8_t *&p)
+    {
+        T value;
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+};
+
+/**
+ * @brief How a string is stored in a record: copied inline, truncated to the room left.
+ *
+ */
+struct AsyncLogString
+{
+    typedef const char *stored_type;
+    static constexpr size_t reserve = 1;
+
+    static void copy(uint8_t *&p, const uint8_t *limit, const char *s, size_t length)
+    {
+        ptrdiff_t room = limit - p - 1;
+        size_t n = room > 0 ? std::min(length, (size_t)room) : 0;
+        memcpy(p, s, n);
+        p[n] = 0;
+        p += n + 1;
+    }
+
+    static const char *decode(const uint8_t *&p)
+    {
+        const char *s = (const char *)p;
+        p += strlen(s) + 1;
+        return s;
+    }
+};
+
+template <>
+struct AsyncLogArg<const char *> : AsyncLogString
+{
+    static void encode(uint8_t *&p, const uint8_t *limit, const char *s)
+    {
+        if (s == NULL)
+            s = "(null)";
+        copy(p, limit, s, strlen(s));
+    }
+};
+
+template <>
+struct AsyncLogArg<char *> : AsyncLogArg<const char *>
+{
+};
+
+inline size_t async_log_snprintf(char *out, size_t size, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out, size, format, args);
+    va_end(args);
+    return n < 0 ? 0 : std::min((size_t)n, size - 1);
+}
+
+/**
+ * @brief Format a record, instantiated per argument list by AsyncLogger::log.
+ *
+ */
+template <class... Args>
+size_t async_log_render(const char *format, const uint8_t *args, char *out, size_t size)
+{
+    const uint8_t *p = args;
+    (void)p;
+    // Braced initialization decodes left to right
+    std::tuple<typename AsyncLogArg<Args>::stored_type...> values{AsyncLogArg<Args>::decode(p)...};
+    return std::apply([&](auto... v)
+                      { return async_log_snprintf(out, size, format, v...); },
+                      values);
+}
+
+/**
+ * @brief An asynchronous logger writing to a file descriptor from a background thread.
+ *
+ */
+class AsyncLogger
+{
+public:
+    /**
+     * @brief Construct a new AsyncLogger object and start its writer thread.
+     *
+     * @param fd The output, standard output by default. Colour is used only if it is a terminal.
+     * @param queue_size The number of records each logging thread can have in flight.
+     * @param policy What to do when a thread's queue is full.
+     */
+    AsyncLogger(int fd = STDOUT_FILENO, size_t queue_size = 1024, AsyncLogPolicy policy = ASYNC_LOG_DROP)
+        : fd(fd), colour(isatty(fd)), queue_size(queue_size), policy(policy),
+          min_level(LOG_LEVEL_DEBUG), num_queues(0), next_queue(0), running(true), dropped_records(0)
+    {
+        // the record timestamps use TscClock; calibrate now, not in the first LOG_* call
+        TscClock::available();
+
+        static std::atomic<uint64_t> serials(0);
+        serial = serials.fetch_add(1) + 1;
+        for (int i = 0; i < ASYNC_LOG_MAX_THREADS; i++)
+            queues[i].store(NULL, std::memory_order_relaxed);
+        thread = std::thread(&AsyncLogger::work, this);
+    }
+
+    /**
+     * @brief Write everything still queued and stop the writer thread.
+     *
+     */
+    ~AsyncLogger()
+    {
+        running.store(false, std::memory_order_release);
+        thread.join();
+        for (int i = 0; i < num_queues.load(); i++)
+            delete queues[i].load();
+    }
+
+    AsyncLogger(const AsyncLogger &) = delete;
+    AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+    /**
+     * @brief Capture a log call. Prefer the LOG_* macros, which check the format.
+     *
+     * @param level One of LOG_LEVEL_*.
+     * @param color One of the COLOR_* of stdout_with_colour.h, 0 for the level's colour.
+     * @param format A printf format string that outlives the logger.
+     * @param args Numbers, pointers or C strings (pass std::string as c_str()).
+     * @return bool False if the record was filtered or dropped.
+     */
+    template <class... Args>
+    bool log(int level, uint8_t color, const char *format, const Args &...args)
+    {
+        if (level < min_level.load(std::memory_order_relaxed))
+            return false;
+
+        SpscQueue<async_log_record_t> *q = queue();
+        async_log_record_t *r = q ? q->claim() : NULL;
+        while (r == NULL && q && policy == ASYNC_LOG_BLOCK)
+        {
+            sched_yield();
+            r = q->claim();
+        }
+        if (r == NULL)
+        {
+            dropped_records.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        constexpr size_t reserve = (0 + ... + AsyncLogArg<typename std::decay<Args>::type>::reserve);
+        static_assert(2 * reserve <= sizeof(r->args), "too many log arguments for ASYNC_LOG_RECORD_SIZE");
+
+        r->t_ns = TscClock::now_ns();
+        r->format = format;
+        r->render = &async_log_render<typename std::decay<Args>::type...>;
+        r->level = level;
+        r->color = color;
+        uint8_t *p = r->args;
+        const uint8_t *limit = r->args + sizeof(r->args) - reserve;
+        (void)p;
+        (void)limit;
+        (AsyncLogArg<typename std::decay<Args>::type>::encode(p, limit, args), ...);
+        q->publish();
+        return true;
+    }
+
+    /**
+     * @brief Set the lowest level logged at run time, above the compile-time RD_KITS_LOG_LEVEL.
+     *
+     */
+    void setLevel(int level) { min_level.store(level, std::memory_order_relaxed); }
+    int getLevel() const { return min_level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Wait until everything logged so far has been written.
+     *
+     */
+    void flush()
+    {
+        for (int i = 0; i < num_queues.load(std::memory_order_acquire); i++)
+            while (!queues[i].load(std::memory_order_acquire)->empty())
+                MonotonicClock::sleep_until_ns(MonotonicClock::now_ns() + 100000);
+    }
+
+    /**
+     * @brief Return the number of records dropped because a queue was full or too many threads logged.
+     *
+     */
+    uint64_t dropped() const { return dropped_records.load(std::memory_order_relaxed); }
+
+private:
+    typedef SpscQueue<async_log_record_t> Queue;
+
+    // Records written per writev
+    static constexpr int BATCH = 128;
+
+    // The calling thread's queue, registered on its first log call
+    Queue *queue()
+    {
+        static thread_local uint64_t cached_serial = 0;
+        static thread_local Queue *cached = NULL;
+        if (cached_serial == serial)
+            return cached;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::thread::id self = std::this_thread::get_id();
+        int n = num_queues.load(std::memory_order_relaxed);
+        Queue *q = NULL;
+        for (int i = 0; i < n && q == NULL; i++)
+            if (owners[i] == self)
+                q = queues[i].load(std::memory_order_relaxed);
+        if (q == NULL)
+        {
+            if (n == ASYNC_LOG_MAX_THREADS)
+                return NULL;
+            q = new Queue(queue_size);
+            owners[n] = self;
+            queues[n].store(q, std::memory_order_relaxed);
+            num_queues.store(n + 1, std::memory_order_release);
+        }
+        cached_serial = serial;
+        cached = q;
+        return q;
+    }
+
+    void work()
+    {
+        for (;;)
+        {
+            bool stop = !running.load(std::memory_order_acquire);
+            if (drain() == 0)
+            {
+                if (stop)
+                    break;
+                MonotonicClock::sleep_until_ns(MonotonicClock::now_ns() + 500000);
+            }
+        }
+    }
+
+    // Format and write one batch from every queue, return the number of records
+    int drain()
+    {
+        struct Line
+        {
+            uint64_t t_ns;
+            int index;
+        };
+        Line order[BATCH];
+        size_t taken[ASYNC_LOG_MAX_THREADS];
+        int count = 0;
+
+        int n = num_queues.load(std::memory_order_acquire);
+        if (n == 0)
+            return 0;
+
+        // A fair share per queue and a rotating start, so one busy thread
+        // cannot fill every batch while the other queues overflow
+        int share = (BATCH + n - 1) / n;
+        int first = next_queue++ % n;
+        for (int i = 0; i < n; i++)
+            taken[i] = 0;
+        for (int j = 0; j < n; j++)
+        {
+            int i = (first + j) % n;
+            Queue *q = queues[i].load(std::memory_order_relaxed);
+            async_log_record_t *r;
+            while (count < BATCH && (int)taken[i] < share && (r = q->peek(taken[i])) != NULL)
+            {
+                format(*r, lines[count], lengths[count], colors[count]);
+                order[count].t_ns = r->t_ns;
+                order[count].index = count;
+                count++;
+                taken[i]++;
+            }
+        }
+        if (count == 0)
+            return 0;
+
+        // Threads drain one after the other, put the batch back in time order
+        std::stable_sort(order, order + count, [](const Line &a, const Line &b)
+                         { return a.t_ns < b.t_ns; });
+
+        int iovcnt = 0;
+        for (int k = 0; k < count; k++)
+        {
+            int i = order[k].index;
+            const char *prefix = colour ? color_code(colors[i]) : NULL;
+            if (prefix)
+                iov[iovcnt++] = make_iov(prefix, strlen(prefix));
+            iov[iovcnt++] = make_iov(lines[i], lengths[i]);
+            if (prefix)
+                iov[iovcnt++] = make_iov("\033[0m", 4);
+        }
+        write_all(iovcnt);
+
+        // Release only after writing, so flush() can wait for empty queues
+        for (int i = 0; i < n; i++)
+            if (taken[i])
+                queues[i].load(std::memory_order_relaxed)->release(taken[i]);
+        return count;
+    }
+
+    void format(const async_log_record_t &r, char *line, size_t &length, uint8_t &color)
+    {
+        static const char *names[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+        static const uint8_t level_colors[] = {0, 0, COLOR_YELLOW, COLOR_RED};
+        int level = std::min((int)r.level, LOG_LEVEL_ERROR);
+
+        size_t n = async_log_snprintf(line, ASYNC_LOG_LINE_SIZE, "[%.6f] %s ", r.t_ns * 1.0e-9, names[level]);
+        n += r.render(r.format, r.args, line + n, ASYNC_LOG_LINE_SIZE - n);
+        if (n == 0 || line[n - 1] != '\n')
+        {
+            if (n == ASYNC_LOG_LINE_SIZE - 1)
+                n--;
+            line[n++] = '\n';
+        }
+        length = n;
+        color = r.color ? r.color : level_colors[level];
+    }
+
+    static const char *color_code(uint8_t color)
+    {
+        switch (color)
+        {
+        case COLOR_RED:
+            return "\033[1;31m";
+        case COLOR_GREEN:
+            return "\033[1;32m";
+        case COLOR_YELLOW:
+            return "\033[1;33m";
+        case COLOR_BLUE:
+            return "\033[1;34m";
+        case COLOR_MAGENTA:
+            return "\033[1;35m";
+        case COLOR_CYAN:
+            return "\033[1;36m";
+        case COLOR_WHITE:
+            return "\033[1;37m";
+        default:
+            return NULL;
+        }
+    }
+
+    static struct iovec make_iov(const char *data, size_t size)
+    {
+        struct iovec v;
+        v.iov_base = (void *)data;
+        v.iov_len = size;
+        return v;
+    }
+
+    // writev until everything is out, resuming after partial writes
+    void write_all(int iovcnt)
+    {
+        struct iovec *v = iov;
+        while (iovcnt > 0)
+        {
+            ssize_t written = writev(fd, v, iovcnt);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            while (iovcnt > 0 && (size_t)written >= v->iov_len)
+            {
+                written -= v->iov_len;
+                v++;
+                iovcnt--;
+            }
+            if (iovcnt > 0)
+            {
+                v->iov_base = (char *)v->iov_base + written;
+                v->iov_len -= written;
+            }
+        }
+    }
+
+    int fd;
+    bool colour;
+    size_t queue_size;
+    AsyncLogPolicy policy;
+    std::atomic<int> min_level;
+    uint64_t serial;
+
+    // One queue per logging thread, appended under mutex and read lock-free by the writer
+    std::mutex mutex;
+    std::thread::id owners[ASYNC_LOG_MAX_THREADS];
+    std::atomic<Queue *> queues[ASYNC_LOG_MAX_THREADS];
+    std::atomic<int> num_queues;
+    unsigned next_queue; // where the writer starts its next batch
+
+    // Writer thread buffers
+    char lines[BATCH][ASYNC_LOG_LINE_SIZE];
+    size_t lengths[BATCH];
+    uint8_t colors[BATCH];
+    struct iovec iov[3 * BATCH];
+
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped_records;
+    std::thread thread;
+};
+
+/**
+ * @brief Return the process-wide logger used by the LOG_* macros, writing to standard output.
+ *
+ */
+inline AsyncLogger &async_logger()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+/**
+ * @brief Log through async_logger(), with the format checked like printf but not evaluated.
+ *
+ */
+#define RD_KITS_LOG(level, color, ...) \
+    ((void)sizeof(printf(__VA_ARGS__)), async_logger().log((level), (color), __VA_ARGS__))
+
+#if RD_KITS_LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) RD_KITS_LOG(LOG_LEVEL_DEBUG, 0, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if RD_KITS_LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) RD_KITS_LOG(LOG_LEVEL_INFO, 0, __VA_ARGS__)
+#define LOG_COLOR(color, ...) RD_KITS_LOG(LOG_LEVEL_INFO, (color), __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#define LOG_COLOR(color, ...) ((void)0)
+#endif
+
+#if RD_KITS_LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) RD_KITS_LOG(LOG_LEVEL_WARN, 0, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if RD_KITS_LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) RD_KITS_LOG(LOG_LEVEL_ERROR, 0, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif // ASYNC_LOG_H
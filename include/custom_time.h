@@ -2,44 +2,286 @@
  * @file custom_time.h
  * @brief This file contains custom time functions.
  *
- * This file contains custom time functions.
+ * This file contains custom time functions and the clocks used by the
+ * time-dependent parts of the library.
  *
+ * All of them count from CLOCK_MONOTONIC, which never jumps under NTP or
+ * manual clock changes. The clocks follow the std::chrono clock interface
+ * (now(), time_point, duration) and add now_ns() for integer nanoseconds,
+ * so components such as PID and MachineState take one as a template
+ * parameter:
+ * - MonotonicClock: clock_gettime(CLOCK_MONOTONIC), a vDSO call on Linux.
+ * - TscClock: reads the x86 time stamp counter and converts it with an
+ *   integer multiply and shift, calibrated once against MonotonicClock.
+ *   The calibration busy-waits 10 ms on first use, so call
+ *   TscClock::available() at startup rather than in a control loop.
+ *   Falls back to MonotonicClock without an invariant TSC.
+ * - SimulatedClock: time set by the caller, per thread, for deterministic
+ *   tests and replays.
  */
 
 #ifndef CUSTOM_TIME_H
 #define CUSTOM_TIME_H
 
-#include <sys/time.h>
+#include <errno.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 /**
- * @brief Get the current time in seconds.
+ * @brief The CLOCK_MONOTONIC clock.
+ *
+ */
+struct MonotonicClock
+{
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<MonotonicClock> time_point;
+    static constexpr bool is_steady = true;
+
+    /**
+     * @brief Get the current time in nanoseconds.
+     *
+     * @return uint64_t The current time in nanoseconds.
+     */
+    static uint64_t now_ns()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    }
+
+    static time_point now() noexcept
+    {
+        return time_point(duration(now_ns()));
+    }
+
+    /**
+     * @brief Sleep until an absolute time, immune to drift from the time spent computing the deadline.
+     *
+     * @param t_ns The wake-up time in nanoseconds.
+     */
+    static void sleep_until_ns(uint64_t t_ns)
+    {
+        timespec ts;
+        ts.tv_sec = t_ns / 1000000000ULL;
+        ts.tv_nsec = t_ns % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        {
+        }
+    }
+};
+
+/**
+ * @brief A clock reading the time stamp counter, on the same time base as MonotonicClock.
  *
- * @return double The current time in seconds.
  */
-double get_time_s_double(void)
+struct TscClock
 {
-    double tm;
-    struct timeval tim;
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<TscClock> time_point;
+    static constexpr bool is_steady = true;
+
+    /**
+     * @brief Get the current time in nanoseconds.
+     *
+     * @return uint64_t The current time in nanoseconds.
+     */
+    static uint64_t now_ns()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        const Calibration &c = calibration();
+        if (c.mult == 0)
+            return MonotonicClock::now_ns();
+        uint64_t ticks = __rdtsc() - c.base_tsc;
+        return c.base_ns + mul_shift32(ticks, c.mult);
+#else
+        return MonotonicClock::now_ns();
+#endif
+    }
 
-    gettimeofday(&tim, NULL);
+    static time_point now() noexcept
+    {
+        return time_point(duration(now_ns()));
+    }
 
-    tm = (double)tim.tv_sec + tim.tv_usec / 1000000.0;
+    /**
+     * @brief Sleep until an absolute time, see MonotonicClock::sleep_until_ns.
+     *
+     * @param t_ns The wake-up time in nanoseconds.
+     */
+    static void sleep_until_ns(uint64_t t_ns)
+    {
+        MonotonicClock::sleep_until_ns(t_ns);
+    }
 
-    return tm;
+    /**
+     * @brief Check if the time stamp counter is used, false when falling back to MonotonicClock.
+     *
+     */
+    static bool available()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return calibration().mult != 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    struct Calibration
+    {
+        uint64_t base_tsc;
+        uint64_t base_ns;
+        uint64_t mult; // nanoseconds per tick, 32.32 fixed point, 0 if unusable
+    };
+
+#if defined(__x86_64__) || defined(__i386__)
+    /**
+     * @brief Return (a * b) >> 32 of the full 128-bit product, truncated to 64 bits.
+     *
+     * 32-bit x86 has no unsigned __int128, so the product is built from
+     * 32-bit halves there; the result is exact either way.
+     */
+    static uint64_t mul_shift32(uint64_t a, uint64_t b)
+    {
+#ifdef __SIZEOF_INT128__
+        return (uint64_t)(((unsigned __int128)a * b) >> 32);
+#else
+        uint64_t ah = a >> 32, al = a & 0xffffffffu;
+        uint64_t bh = b >> 32, bl = b & 0xffffffffu;
+        return ((ah * bh) << 32) + ah * bl + al * bh + ((al * bl) >> 32);
+#endif
+    }
+
+    static Calibration calibrate()
+    {
+        Calibration c = {0, 0, 0};
+
+        // Invariant TSC: constant rate across P/C-states
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8)))
+            return c;
+
+        uint64_t ns0 = MonotonicClock::now_ns();
+        uint64_t tsc0 = __rdtsc();
+        uint64_t ns1 = ns0;
+        while (ns1 - ns0 < 10000000)
+            ns1 = MonotonicClock::now_ns();
+        uint64_t tsc1 = __rdtsc();
+
+        if (tsc1 <= tsc0)
+            return c;
+
+        // ns1 - ns0 is about 1e7, so the shifted value fits in 64 bits
+        c.mult = ((ns1 - ns0) << 32) / (tsc1 - tsc0);
+        c.base_tsc = tsc1;
+        c.base_ns = ns1;
+        return c;
+    }
+
+    static const Calibration &calibration()
+    {
+        static const Calibration c = calibrate();
+        return c;
+    }
+#endif
+};
+
+/**
+ * @brief A clock driven by the caller.
+ *
+ * The time is kept per thread, so parallel tests or replays each own their clock.
+ */
+struct SimulatedClock
+{
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<SimulatedClock> time_point;
+    static constexpr bool is_steady = true;
+
+    /**
+     * @brief Get the simulated time in nanoseconds.
+     *
+     * @return uint64_t The simulated time in nanoseconds.
+     */
+    static uint64_t now_ns()
+    {
+        return storage();
+    }
+
+    static time_point now() noexcept
+    {
+        return time_point(duration(now_ns()));
+    }
+
+    /**
+     * @brief "Sleep" by moving the simulated time forward to t_ns.
+     *
+     * @param t_ns The wake-up time in nanoseconds.
+     */
+    static void sleep_until_ns(uint64_t t_ns)
+    {
+        if (t_ns > storage())
+            storage() = t_ns;
+    }
+
+    /**
+     * @brief Set the simulated time of the calling thread.
+     *
+     * @param t_ns The time in nanoseconds.
+     */
+    static void set_ns(uint64_t t_ns)
+    {
+        storage() = t_ns;
+    }
+
+    /**
+     * @brief Advance the simulated time of the calling thread.
+     *
+     * @param dt_ns The step in nanoseconds.
+     */
+    static void advance_ns(uint64_t dt_ns)
+    {
+        storage() += dt_ns;
+    }
+
+private:
+    static uint64_t &storage()
+    {
+        static thread_local uint64_t t_ns = 0;
+        return t_ns;
+    }
+};
+
+/**
+ * @brief Get the current time in seconds.
+ *
+ * @return double The current time in seconds.
+ */
+inline double get_time_s_double(void)
+{
+    return MonotonicClock::now_ns() * 1.0e-9;
 }
 
 /**
- * @brief Get the current time in milliseconds.
+ * @brief Get the current time in nanoseconds.
  *
- * @return uint64_t The current time in milliseconds.
+ * @return uint64_t The current time in nanoseconds.
  */
-uint64_t get_time_now_us()
+inline uint64_t get_time_now_ns()
 {
-    timeval tim;
-    gettimeofday(&tim, NULL);
-    return 1.0e3 * tim.tv_sec + tim.tv_usec * 1.0e-3;
+    return MonotonicClock::now_ns();
 }
 
 /**
@@ -47,11 +289,19 @@ uint64_t get_time_now_us()
  *
  * @return uint64_t The current time in microseconds.
  */
-uint64_t get_time_now_ms()
+inline uint64_t get_time_now_us()
+{
+    return MonotonicClock::now_ns() / 1000;
+}
+
+/**
+ * @brief Get the current time in milliseconds.
+ *
+ * @return uint64_t The current time in milliseconds.
+ */
+inline uint64_t get_time_now_ms()
 {
-    timeval tim;
-    gettimeofday(&tim, NULL);
-    return 1.0e6 * tim.tv_sec + tim.tv_usec;
+    return MonotonicClock::now_ns() / 1000000;
 }
 
 /**
@@ -59,11 +309,9 @@ uint64_t get_time_now_ms()
  *
  * @return uint64_t The current time in seconds.
  */
-uint64_t get_time_now_s()
+inline uint64_t get_time_now_s()
 {
-    timeval tim;
-    gettimeofday(&tim, NULL);
-    return tim.tv_sec;
+    return MonotonicClock::now_ns() / 1000000000;
 }
 
 #endif
@@ -43,7 +43,7 @@ typedef struct
 } pose2d_t;
 
 /**
- * @brief A 2D pose with covariance.
+ * @brief An encoder reading, see enc_update() in odometry.h.
  *
  */
 typedef struct
@@ -0,0 +1,266 @@
+/**
+ * @file extended_kf.h
+ *
+ * @brief This file contains the ExtendedKalmanFilter class.
+ *
+ * The process and measurement models are functors supplied by the user,
+ * together with their Jacobians. Everything is sized at compile time, so a
+ * step does not allocate and the models are inlined into it.
+ *
+ * The innovation is y - h(x) unless the measurement functor has a
+ * residual() member, found at compile time. Give one for any angle in the
+ * measurement: a bearing measured at +3.1 rad against a prediction of -3.1
+ * is 0.08 rad off, not 6.2.
+ *
+ * @code{.cpp}
+ * struct Process
+ * {
+ *     // x_next = f(x, dt), F = df/dx
+ *     void operator()(const Eigen::Vector4d &x, double dt, Eigen::Vector4d &x_next, Eigen::Matrix4d &F) const;
+ * };
+ *
+ * struct RangeBearing
+ * {
+ *     // z = h(x), H = dh/dx
+ *     void operator()(const Eigen::Vector4d &x, Eigen::Vector2d &z, Eigen::Matrix<double, 2, 4> &H) const;
+ *
+ *     // optional, v = y - z with the bearing wrapped to (-pi, pi]
+ *     void residual(const Eigen::Vector2d &y, const Eigen::Vector2d &z, Eigen::Vector2d &v) const
+ *     {
+ *         v = y - z;
+ *         v(1) = std::remainder(v(1), 2 * M_PI);
+ *     }
+ * };
+ *
+ * ExtendedKalmanFilter<4, 2, Process, RangeBearing> ekf(dt, Process(), RangeBearing(), Q, R, P);
+ * @endcode
+ */
+
+#ifndef EXTENDED_KF_H
+#define EXTENDED_KF_H
+
+#include "standard_kf.h"
+
+/**
+ * @brief Set v = y - z, or call h.residual(y, z, v) if the measurement model has one.
+ *
+ */
+template <class Measurement, class Vector>
+inline auto kf_measurement_residual(const Measurement &h, const Vector &y, const Vector &z, Vector &v, int)
+    -> decltype(h.residual(y, z, v), void())
+{
+    h.residual(y, z, v);
+}
+
+template <class Measurement, class Vector>
+inline void kf_measurement_residual(const Measurement &, const Vector &y, const Vector &z, Vector &v, long)
+{
+    v = y - z;
+}
+
+template <class Measurement, class Vector>
+inline void kf_measurement_residual(const Measurement &h, const Vector &y, const Vector &z, Vector &v)
+{
+    kf_measurement_residual(h, y, z, v, 0);
+}
+
+/**
+ * @brief Set z to the weighted mean of the columns of Z, or call h.mean(Z, W, z) if the measurement model has one.
+ *
+ */
+template <class Measurement, class Points, class Weights, class Vector>
+inline auto kf_measurement_mean(const Measurement &h, const Points &Z, const Weights &W, Vector &z, int)
+    -> decltype(h.mean(Z, W, z), void())
+{
+    h.mean(Z, W, z);
+}
+
+template <class Measurement, class Points, class Weights, class Vector>
+inline void kf_measurement_mean(const Measurement &, const Points &Z, const Weights &W, Vector &z, long)
+{
+    z.noalias() = Z * W;
+}
+
+template <class Measurement, class Points, class Weights, class Vector>
+inline void kf_measurement_mean(const Measurement &h, const Points &Z, const Weights &W, Vector &z)
+{
+    kf_measurement_mean(h, Z, W, z, 0);
+}
+
+/**
+ * @brief Extended Kalman filter over user-supplied models.
+ *
+ * @tparam N The state size.
+ * @tparam M The measurement size.
+ * @tparam Process The process model functor.
+ * @tparam Measurement The measurement model functor.
+ */
+template <int N, int M, class Process, class Measurement>
+class ExtendedKalmanFilter
+{
+    static_assert(N > 0 && M > 0, "ExtendedKalmanFilter needs fixed state and measurement sizes");
+
+public:
+    typedef typename KalmanFilter<N, M>::StateVector StateVector;
+    typedef typename KalmanFilter<N, M>::MeasurementVector MeasurementVector;
+    typedef typename KalmanFilter<N, M>::StateMatrix StateMatrix;
+    typedef typename KalmanFilter<N, M>::OutputMatrix OutputMatrix;
+    typedef typename KalmanFilter<N, M>::MeasurementMatrix MeasurementMatrix;
+    typedef typename KalmanFilter<N, M>::GainMatrix GainMatrix;
+
+    /**
+     * @brief Construct a new ExtendedKalmanFilter object.
+     *
+     * @param dt The time step used by update(y).
+     * @param f The process model.
+     * @param h The measurement model.
+     * @param Q The process noise covariance.
+     * @param R The measurement noise covariance.
+     * @param P The initial estimate error covariance.
+     */
+    ExtendedKalmanFilter(
+        double dt,
+        const Process &f,
+        const Measurement &h,
+        const StateMatrix &Q,
+        const MeasurementMatrix &R,
+        const StateMatrix &P)
+        : f(f), h(h), Q(Q), R(R), P0(P), dt(dt), initialized(false)
+    {
+        I.setIdentity();
+    }
+
+    /**
+     * @brief Initialize the filter with initial states as zero.
+     *
+     */
+    void init()
+    {
+        x_hat.setZero();
+        P = P0;
+        t = 0;
+        initialized = true;
+    }
+
+    /**
+     * @brief Initialize the filter with a guess for initial states.
+     *
+     * @param t0 The initial time.
+     * @param x0 The initial state.
+     */
+    void init(double t0, const StateVector &x0)
+    {
+        x_hat = x0;
+        P = P0;
+        t = t0;
+        initialized = true;
+    }
+
+    /**
+     * @brief Predict by the constant time step and correct with y.
+     *
+     * @param y The measurement.
+     */
+    void update(const MeasurementVector &y)
+    {
+        if (!initialized)
+            throw std::runtime_error("Filter is not initialized!");
+
+        propagate(dt);
+        t += dt;
+        correctWith(y);
+    }
+
+    /**
+     * @brief Propagate the estimate to time t, a no-op if t is not ahead of the filter.
+     *
+     * @param t The target time.
+     */
+    void predict(double t)
+    {
+        if (!initialized)
+            throw std::runtime_error("Filter is not initialized!");
+
+        if (t <= this->t)
+            return;
+
+        propagate(t - this->t);
+        this->t = t;
+    }
+
+    /**
+     * @brief Correct the estimate with a measurement taken at time t.
+     *
+     * @param y The measurement.
+     * @param t The measurement time.
+     */
+    void correct(const MeasurementVector &y, double t)
+    {
+        predict(t);
+        correctWith(y);
+    }
+
+    /**
+     * @brief Return the current state, covariance and time.
+     *
+     */
+    StateVector state() { return x_hat; }
+    const StateMatrix &covariance() const { return P; }
+    double time() { return t; }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    void propagate(double step)
+    {
+        f(x_hat, step, x_tmp, F);
+        x_hat = x_tmp;
+        P_tmp.noalias() = F * P;
+        P.noalias() = P_tmp * F.transpose();
+        P += Q;
+    }
+
+    void correctWith(const MeasurementVector &y)
+    {
+        h(x_hat, z, H);
+
+        PHt.noalias() = P * H.transpose();
+        S.noalias() = H * PHt;
+        S += R;
+        K.noalias() = PHt * S.inverse();
+
+        kf_measurement_residual(h, y, z, v);
+        x_hat.noalias() += K * v;
+        P_tmp.noalias() = (I - K * H) * P;
+        P = P_tmp;
+    }
+
+    // Models
+    Process f;
+    Measurement h;
+
+    // Noise and initial covariances
+    StateMatrix Q;
+    MeasurementMatrix R;
+    StateMatrix P0;
+
+    // Discrete time step and current time
+    double dt, t;
+
+    // Is the filter initialized?
+    bool initialized;
+
+    // Estimate
+    StateVector x_hat;
+    StateMatrix P;
+
+    // Workspace
+    StateVector x_tmp;
+    StateMatrix F, P_tmp, I;
+    OutputMatrix H;
+    GainMatrix PHt, K;
+    MeasurementMatrix S;
+    MeasurementVector z, v;
+};
+
+#endif // EXTENDED_KF_H
@@ -12,6 +12,10 @@
 #include "custom_typedef.h"
 #include "math.h"
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 /**
  * @brief Calculate the distance between two points.
  *
@@ -19,7 +23,7 @@
  * @param point2 The second point.
  * @return float The distance between the two points.
  */
-float pythagoras(point2d_t point1, point2d_t point2)
+inline float pythagoras(point2d_t point1, point2d_t point2)
 {
     return sqrt((point2.x - point1.x) * (point2.x - point1.x) + (point2.y - point1.y) * (point2.y - point1.y));
 }
@@ -33,7 +37,7 @@ float pythagoras(point2d_t point1, point2d_t point2)
  * @param y1 The y coordinate of the second point.
  * @return float The distance between the two points.
  */
-float pythagoras(float x0, float y0, float x1, float y1)
+inline float pythagoras(float x0, float y0, float x1, float y1)
 {
     return sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
 }
@@ -49,7 +53,7 @@ float pythagoras(float x0, float y0, float x1, float y1)
  *
  * @return bool True if the point is inside the rectangle, false otherwise.
  */
-bool is_inside_rectangle(point2d_t point, int field_max_x, int field_min_x, int field_max_y, int field_min_y)
+inline bool is_inside_rectangle(point2d_t point, int field_max_x, int field_min_x, int field_max_y, int field_min_y)
 {
     return (point.x > field_min_x && point.x < field_max_x && point.y > field_min_y && point.y < field_max_y);
 }
@@ -66,7 +70,7 @@ bool is_inside_rectangle(point2d_t point, int field_max_x, int field_min_x, int
  *
  * @return bool True if the point is inside the rectangle, false otherwise.
  */
-bool is_inside_rectangle(float x, float y, int field_max_x, int field_min_x, int field_max_y, int field_min_y)
+inline bool is_inside_rectangle(float x, float y, int field_max_x, int field_min_x, int field_max_y, int field_min_y)
 {
     return (x > field_min_x && x < field_max_x && y > field_min_y && y < field_max_y);
 }
@@ -83,7 +87,7 @@ bool is_inside_rectangle(float x, float y, int field_max_x, int field_min_x, int
  *
  * @return float The area of the triangle.
  * */
-float calc_area(int x1, int y1, int x2, int y2, int x3, int y3)
+inline float calc_area(int x1, int y1, int x2, int y2, int x3, int y3)
 {
     return abs((x1 * (y2 - y3) + x2 * (y3 - y1) + x3 * (y1 - y2)) / 2.0);
 }
@@ -102,7 +106,7 @@ float calc_area(int x1, int y1, int x2, int y2, int x3, int y3)
  *
  * @return bool True if the point is inside the triangle, false otherwise.
  */
-bool check_point_is_inside_triangle(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3)
+inline bool check_point_is_inside_triangle(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3)
 {
     float A = calc_area(x1, y1, x2, y2, x3, y3);
     float A1 = calc_area(x, y, x2, y2, x3, y3);
@@ -125,7 +129,7 @@ bool check_point_is_inside_triangle(int x, int y, int x1, int y1, int x2, int y2
  *
  * @return bool True if the point is inside the triangle, false otherwise.
  */
-bool check_point_is_inside_triangle(point2d_t point, int x1, int y1, int x2, int y2, int x3, int y3)
+inline bool check_point_is_inside_triangle(point2d_t point, int x1, int y1, int x2, int y2, int x3, int y3)
 {
     float A = calc_area(x1, y1, x2, y2, x3, y3);
     float A1 = calc_area(point.x, point.y, x2, y2, x3, y3);
@@ -135,4 +139,592 @@ bool check_point_is_inside_triangle(point2d_t point, int x1, int y1, int x2, int
     return (A == A1 + A2 + A3);
 }
 
+/*
+ * Batch versions
+ *
+ * The *_batch functions below apply the functions above to whole arrays of
+ * points, given either as point2d_t (AoS) or as separate x and y arrays
+ * (SoA). Each has a scalar kernel and SSE2/AVX2 (x86) or NEON (AArch64) kernels;
+ * the widest one the CPU supports is picked once at run time. The SIMD
+ * kernels do not fuse multiply-adds and GCC is told not to contract the
+ * scalar kernel, so every kernel gives bit-identical results (with clang,
+ * build with -ffp-contract=off when targeting FMA).
+ */
+
+/**
+ * @brief The kernel families the batch functions can use.
+ *
+ */
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_NEON
+};
+
+// Byte masks for up to 8 lanes, indexed by a movemask result
+struct ExtendedMathMaskTable
+{
+    uint64_t bytes[256];
+
+    constexpr ExtendedMathMaskTable() : bytes()
+    {
+        for (int i = 0; i < 256; i++)
+            for (int k = 0; k < 8; k++)
+                if ((i >> k) & 1)
+                    bytes[i] |= 1ULL << (8 * k);
+    }
+};
+
+inline const ExtendedMathMaskTable &extended_math_mask_table()
+{
+    static constexpr ExtendedMathMaskTable table;
+    return table;
+}
+
+template <bool AOS>
+inline void extended_math_load(const float *x, const float *y, const point2d_t *p, size_t i, float &px, float &py)
+{
+    if (AOS)
+    {
+        px = p[i].x;
+        py = p[i].y;
+    }
+    else
+    {
+        px = x[i];
+        py = y[i];
+    }
+}
+
+// A triangle as three edge functions e(p) = a * px + b * py + c, >= 0 on the inner side of a counter-clockwise edge
+typedef struct
+{
+    float a[3];
+    float b[3];
+    float c[3];
+} triangle_edges_t;
+
+inline triangle_edges_t extended_math_triangle_edges(float x1, float y1, float x2, float y2, float x3, float y3)
+{
+    const float vx[3] = {x1, x2, x3};
+    const float vy[3] = {y1, y2, y3};
+    triangle_edges_t e;
+    for (int k = 0; k < 3; k++)
+    {
+        int j = (k + 1) % 3;
+        e.a[k] = -(vy[j] - vy[k]);
+        e.b[k] = vx[j] - vx[k];
+        e.c[k] = (vy[j] - vy[k]) * vx[k] - (vx[j] - vx[k]) * vy[k];
+    }
+    return e;
+}
+
+// Keep a * b + c as two roundings in every kernel, also under -mfma
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/* SCALAR KERNELS */
+
+template <bool AOS>
+void pythagoras_batch_scalar(const float *x, const float *y, const point2d_t *p, size_t n, float x0, float y0, float *out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float px, py;
+        extended_math_load<AOS>(x, y, p, i, px, py);
+        float dx = px - x0, dy = py - y0;
+        out[i] = sqrtf(dx * dx + dy * dy);
+    }
+}
+
+template <bool AOS>
+size_t is_inside_rectangle_batch_scalar(const float *x, const float *y, const point2d_t *p, size_t n,
+                                        float max_x, float min_x, float max_y, float min_y, uint8_t *mask)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        float px, py;
+        extended_math_load<AOS>(x, y, p, i, px, py);
+        mask[i] = px > min_x && px < max_x && py > min_y && py < max_y;
+        count += mask[i];
+    }
+    return count;
+}
+
+template <bool AOS>
+size_t is_inside_triangle_batch_scalar(const float *x, const float *y, const point2d_t *p, size_t n,
+                                       const triangle_edges_t &e, uint8_t *mask)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        float px, py;
+        extended_math_load<AOS>(x, y, p, i, px, py);
+        float d0 = e.a[0] * px + e.b[0] * py + e.c[0];
+        float d1 = e.a[1] * px + e.b[1] * py + e.c[1];
+        float d2 = e.a[2] * px + e.b[2] * py + e.c[2];
+        bool has_neg = d0 < 0 || d1 < 0 || d2 < 0;
+        bool has_pos = d0 > 0 || d1 > 0 || d2 > 0;
+        mask[i] = !(has_neg && has_pos);
+        count += mask[i];
+    }
+    return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* SSE2 KERNELS */
+
+template <bool AOS>
+__attribute__((target("sse2"))) inline void extended_math_load4(const float *x, const float *y, const point2d_t *p, size_t i, __m128 &vx, __m128 &vy)
+{
+    if (AOS)
+    {
+        __m128 a = _mm_loadu_ps(&p[i].x);
+        __m128 b = _mm_loadu_ps(&p[i + 2].x);
+        vx = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        vy = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+    else
+    {
+        vx = _mm_loadu_ps(x + i);
+        vy = _mm_loadu_ps(y + i);
+    }
+}
+
+template <bool AOS>
+__attribute__((target("sse2"))) void pythagoras_batch_sse2(const float *x, const float *y, const point2d_t *p, size_t n, float x0, float y0, float *out)
+{
+    const __m128 ox = _mm_set1_ps(x0), oy = _mm_set1_ps(y0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 vx, vy;
+        extended_math_load4<AOS>(x, y, p, i, vx, vy);
+        __m128 dx = _mm_sub_ps(vx, ox), dy = _mm_sub_ps(vy, oy);
+        _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+    }
+    pythagoras_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i, x0, y0, out + i);
+}
+
+template <bool AOS>
+__attribute__((target("sse2"))) size_t is_inside_rectangle_batch_sse2(const float *x, const float *y, const point2d_t *p, size_t n,
+                                                                      float max_x, float min_x, float max_y, float min_y, uint8_t *mask)
+{
+    const __m128 lx = _mm_set1_ps(min_x), hx = _mm_set1_ps(max_x), ly = _mm_set1_ps(min_y), hy = _mm_set1_ps(max_y);
+    const ExtendedMathMaskTable &table = extended_math_mask_table();
+    size_t count = 0, i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 vx, vy;
+        extended_math_load4<AOS>(x, y, p, i, vx, vy);
+        __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(vx, lx), _mm_cmplt_ps(vx, hx)),
+                               _mm_and_ps(_mm_cmpgt_ps(vy, ly), _mm_cmplt_ps(vy, hy)));
+        int bits = _mm_movemask_ps(in);
+        uint32_t bytes = (uint32_t)table.bytes[bits];
+        memcpy(mask + i, &bytes, 4);
+        count += __builtin_popcount(bits);
+    }
+    return count + is_inside_rectangle_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i,
+                                                         max_x, min_x, max_y, min_y, mask + i);
+}
+
+template <bool AOS>
+__attribute__((target("sse2"))) size_t is_inside_triangle_batch_sse2(const float *x, const float *y, const point2d_t *p, size_t n,
+                                                                     const triangle_edges_t &e, uint8_t *mask)
+{
+    const ExtendedMathMaskTable &table = extended_math_mask_table();
+    const __m128 zero = _mm_setzero_ps();
+    size_t count = 0, i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 vx, vy;
+        extended_math_load4<AOS>(x, y, p, i, vx, vy);
+        __m128 neg = zero, pos = zero;
+        for (int k = 0; k < 3; k++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(e.a[k]), vx), _mm_mul_ps(_mm_set1_ps(e.b[k]), vy)), _mm_set1_ps(e.c[k]));
+            neg = _mm_or_ps(neg, _mm_cmplt_ps(d, zero));
+            pos = _mm_or_ps(pos, _mm_cmpgt_ps(d, zero));
+        }
+        int bits = ~_mm_movemask_ps(_mm_and_ps(neg, pos)) & 0xf;
+        uint32_t bytes = (uint32_t)table.bytes[bits];
+        memcpy(mask + i, &bytes, 4);
+        count += __builtin_popcount(bits);
+    }
+    return count + is_inside_triangle_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i, e, mask + i);
+}
+
+/* AVX2 KERNELS */
+
+template <bool AOS>
+__attribute__((target("avx2"))) inline void extended_math_load8(const float *x, const float *y, const point2d_t *p, size_t i, __m256 &vx, __m256 &vy)
+{
+    if (AOS)
+    {
+        // Points 0-3 and 4-7, deinterleaved per 128-bit lane, then the 64-bit quarters put back in order
+        __m256 a = _mm256_loadu_ps(&p[i].x);
+        __m256 b = _mm256_loadu_ps(&p[i + 4].x);
+        vx = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), 0xd8));
+        vy = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), 0xd8));
+    }
+    else
+    {
+        vx = _mm256_loadu_ps(x + i);
+        vy = _mm256_loadu_ps(y + i);
+    }
+}
+
+template <bool AOS>
+__attribute__((target("avx2"))) void pythagoras_batch_avx2(const float *x, const float *y, const point2d_t *p, size_t n, float x0, float y0, float *out)
+{
+    const __m256 ox = _mm256_set1_ps(x0), oy = _mm256_set1_ps(y0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 vx, vy;
+        extended_math_load8<AOS>(x, y, p, i, vx, vy);
+        __m256 dx = _mm256_sub_ps(vx, ox), dy = _mm256_sub_ps(vy, oy);
+        _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))));
+    }
+    pythagoras_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i, x0, y0, out + i);
+}
+
+template <bool AOS>
+__attribute__((target("avx2"))) size_t is_inside_rectangle_batch_avx2(const float *x, const float *y, const point2d_t *p, size_t n,
+                                                                      float max_x, float min_x, float max_y, float min_y, uint8_t *mask)
+{
+    const __m256 lx = _mm256_set1_ps(min_x), hx = _mm256_set1_ps(max_x), ly = _mm256_set1_ps(min_y), hy = _mm256_set1_ps(max_y);
+    const ExtendedMathMaskTable &table = extended_math_mask_table();
+    size_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 vx, vy;
+        extended_math_load8<AOS>(x, y, p, i, vx, vy);
+        __m256 in = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(vx, lx, _CMP_GT_OQ), _mm256_cmp_ps(vx, hx, _CMP_LT_OQ)),
+                                  _mm256_and_ps(_mm256_cmp_ps(vy, ly, _CMP_GT_OQ), _mm256_cmp_ps(vy, hy, _CMP_LT_OQ)));
+        int bits = _mm256_movemask_ps(in);
+        memcpy(mask + i, &table.bytes[bits], 8);
+        count += __builtin_popcount(bits);
+    }
+    return count + is_inside_rectangle_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i,
+                                                         max_x, min_x, max_y, min_y, mask + i);
+}
+
+template <bool AOS>
+__attribute__((target("avx2"))) size_t is_inside_triangle_batch_avx2(const float *x, const float *y, const point2d_t *p, size_t n,
+                                                                     const triangle_edges_t &e, uint8_t *mask)
+{
+    const ExtendedMathMaskTable &table = extended_math_mask_table();
+    const __m256 zero = _mm256_setzero_ps();
+    size_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 vx, vy;
+        extended_math_load8<AOS>(x, y, p, i, vx, vy);
+        __m256 neg = zero, pos = zero;
+        for (int k = 0; k < 3; k++)
+        {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(e.a[k]), vx), _mm256_mul_ps(_mm256_set1_ps(e.b[k]), vy)), _mm256_set1_ps(e.c[k]));
+            neg = _mm256_or_ps(neg, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+            pos = _mm256_or_ps(pos, _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+        }
+        int bits = ~_mm256_movemask_ps(_mm256_and_ps(neg, pos)) & 0xff;
+        memcpy(mask + i, &table.bytes[bits], 8);
+        count += __builtin_popcount(bits);
+    }
+    return count + is_inside_triangle_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i, e, mask + i);
+}
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+/* NEON KERNELS */
+
+// AArch64 only: ARMv7 NEON has no vaddvq_u32 or vsqrtq_f32 and flushes
+// denormals, so 32-bit ARM uses the scalar kernels
+
+template <bool AOS>
+inline void extended_math_load4(const float *x, const float *y, const point2d_t *p, size_t i, float32x4_t &vx, float32x4_t &vy)
+{
+    if (AOS)
+    {
+        float32x4x2_t v = vld2q_f32(&p[i].x);
+        vx = v.val[0];
+        vy = v.val[1];
+    }
+    else
+    {
+        vx = vld1q_f32(x + i);
+        vy = vld1q_f32(y + i);
+    }
+}
+
+// Store 4 lane masks as 0/1 bytes and return how many are set
+inline size_t extended_math_store_mask4(uint32x4_t in, uint8_t *mask)
+{
+    uint16x4_t half = vmovn_u32(vshrq_n_u32(in, 31));
+    uint8x8_t bytes = vmovn_u16(vcombine_u16(half, half));
+    vst1_lane_u32((uint32_t *)(void *)mask, vreinterpret_u32_u8(bytes), 0);
+    return vaddvq_u32(vshrq_n_u32(in, 31));
+}
+
+template <bool AOS>
+void pythagoras_batch_neon(const float *x, const float *y, const point2d_t *p, size_t n, float x0, float y0, float *out)
+{
+    const float32x4_t ox = vdupq_n_f32(x0), oy = vdupq_n_f32(y0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t vx, vy;
+        extended_math_load4<AOS>(x, y, p, i, vx, vy);
+        float32x4_t dx = vsubq_f32(vx, ox), dy = vsubq_f32(vy, oy);
+        vst1q_f32(out + i, vsqrtq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy))));
+    }
+    pythagoras_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i, x0, y0, out + i);
+}
+
+template <bool AOS>
+size_t is_inside_rectangle_batch_neon(const float *x, const float *y, const point2d_t *p, size_t n,
+                                      float max_x, float min_x, float max_y, float min_y, uint8_t *mask)
+{
+    const float32x4_t lx = vdupq_n_f32(min_x), hx = vdupq_n_f32(max_x), ly = vdupq_n_f32(min_y), hy = vdupq_n_f32(max_y);
+    size_t count = 0, i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t vx, vy;
+        extended_math_load4<AOS>(x, y, p, i, vx, vy);
+        uint32x4_t in = vandq_u32(vandq_u32(vcgtq_f32(vx, lx), vcltq_f32(vx, hx)),
+                                  vandq_u32(vcgtq_f32(vy, ly), vcltq_f32(vy, hy)));
+        count += extended_math_store_mask4(in, mask + i);
+    }
+    return count + is_inside_rectangle_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i,
+                                                         max_x, min_x, max_y, min_y, mask + i);
+}
+
+template <bool AOS>
+size_t is_inside_triangle_batch_neon(const float *x, const float *y, const point2d_t *p, size_t n,
+                                     const triangle_edges_t &e, uint8_t *mask)
+{
+    const float32x4_t zero = vdupq_n_f32(0);
+    size_t count = 0, i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t vx, vy;
+        extended_math_load4<AOS>(x, y, p, i, vx, vy);
+        uint32x4_t neg = vdupq_n_u32(0), pos = vdupq_n_u32(0);
+        for (int k = 0; k < 3; k++)
+        {
+            // vmulq + vaddq rather than vmlaq, which may fuse
+            float32x4_t d = vaddq_f32(vaddq_f32(vmulq_f32(vdupq_n_f32(e.a[k]), vx), vmulq_f32(vdupq_n_f32(e.b[k]), vy)), vdupq_n_f32(e.c[k]));
+            neg = vorrq_u32(neg, vcltq_f32(d, zero));
+            pos = vorrq_u32(pos, vcgtq_f32(d, zero));
+        }
+        count += extended_math_store_mask4(vmvnq_u32(vandq_u32(neg, pos)), mask + i);
+    }
+    return count + is_inside_triangle_batch_scalar<AOS>(x + (AOS ? 0 : i), y + (AOS ? 0 : i), p + (AOS ? i : 0), n - i, e, mask + i);
+}
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+/* DISPATCH */
+
+/**
+ * @brief The kernels used by the batch functions.
+ *
+ */
+struct ExtendedMathKernels
+{
+    int level; // SimdLevel
+    void (*pythagoras[2])(const float *, const float *, const point2d_t *, size_t, float, float, float *);
+    size_t (*rectangle[2])(const float *, const float *, const point2d_t *, size_t, float, float, float, float, uint8_t *);
+    size_t (*triangle[2])(const float *, const float *, const point2d_t *, size_t, const triangle_edges_t &, uint8_t *);
+};
+
+/**
+ * @brief Return the best SimdLevel this CPU supports.
+ *
+ */
+inline int extended_math_best_simd()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+    return SIMD_SCALAR;
+#elif defined(__aarch64__)
+    return SIMD_NEON;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+#define EXTENDED_MATH_KERNELS(k, suffix)                                                     \
+    do                                                                                       \
+    {                                                                                        \
+        (k).pythagoras[0] = pythagoras_batch_##suffix<false>;                                \
+        (k).pythagoras[1] = pythagoras_batch_##suffix<true>;                                 \
+        (k).rectangle[0] = is_inside_rectangle_batch_##suffix<false>;                        \
+        (k).rectangle[1] = is_inside_rectangle_batch_##suffix<true>;                         \
+        (k).triangle[0] = is_inside_triangle_batch_##suffix<false>;                          \
+        (k).triangle[1] = is_inside_triangle_batch_##suffix<true>;                           \
+    } while (0)
+
+inline bool extended_math_select_simd(ExtendedMathKernels &k, int level)
+{
+    int best = extended_math_best_simd();
+    switch (level)
+    {
+    case SIMD_SCALAR:
+        EXTENDED_MATH_KERNELS(k, scalar);
+        break;
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_SSE2:
+        if (best < SIMD_SSE2)
+            return false;
+        EXTENDED_MATH_KERNELS(k, sse2);
+        break;
+    case SIMD_AVX2:
+        if (best < SIMD_AVX2)
+            return false;
+        EXTENDED_MATH_KERNELS(k, avx2);
+        break;
+#endif
+#if defined(__aarch64__)
+    case SIMD_NEON:
+        EXTENDED_MATH_KERNELS(k, neon);
+        break;
+#endif
+    default:
+        return false;
+    }
+    k.level = level;
+    return true;
+}
+
+inline ExtendedMathKernels &extended_math_kernels()
+{
+    static ExtendedMathKernels kernels = []()
+    {
+        ExtendedMathKernels k;
+        extended_math_select_simd(k, extended_math_best_simd());
+        return k;
+    }();
+    return kernels;
+}
+
+/**
+ * @brief Select the kernels used by the batch functions, e.g. SIMD_SCALAR to compare against.
+ *
+ * Not thread safe; call it before the batch functions are used.
+ *
+ * @param level A SimdLevel.
+ * @return bool False if the CPU does not support it; the selection is unchanged.
+ */
+inline bool extended_math_set_simd(int level)
+{
+    return extended_math_select_simd(extended_math_kernels(), level);
+}
+
+/**
+ * @brief Return the SimdLevel in use.
+ *
+ */
+inline int extended_math_get_simd()
+{
+    return extended_math_kernels().level;
+}
+
+/**
+ * @brief Calculate the distance from an origin to every point.
+ *
+ * @param points The points.
+ * @param n The number of points.
+ * @param origin The origin.
+ * @param distance The distances, n floats.
+ */
+inline void pythagoras_batch(const point2d_t *points, size_t n, point2d_t origin, float *distance)
+{
+    extended_math_kernels().pythagoras[1](NULL, NULL, points, n, origin.x, origin.y, distance);
+}
+
+/**
+ * @brief Calculate the distance from an origin to every point, with the coordinates in separate arrays.
+ *
+ */
+inline void pythagoras_batch(const float *x, const float *y, size_t n, float x0, float y0, float *distance)
+{
+    extended_math_kernels().pythagoras[0](x, y, NULL, n, x0, y0, distance);
+}
+
+/**
+ * @brief Check which points are inside a rectangle, like is_inside_rectangle().
+ *
+ * @param points The points.
+ * @param n The number of points.
+ * @param field_max_x The maximum x coordinate of the field.
+ * @param field_min_x The minimum x coordinate of the field.
+ * @param field_max_y The maximum y coordinate of the field.
+ * @param field_min_y The minimum y coordinate of the field.
+ * @param mask 1 for a point inside, 0 otherwise, n bytes.
+ * @return size_t The number of points inside.
+ */
+inline size_t is_inside_rectangle_batch(const point2d_t *points, size_t n, float field_max_x, float field_min_x, float field_max_y, float field_min_y, uint8_t *mask)
+{
+    return extended_math_kernels().rectangle[1](NULL, NULL, points, n, field_max_x, field_min_x, field_max_y, field_min_y, mask);
+}
+
+/**
+ * @brief Check which points are inside a rectangle, with the coordinates in separate arrays.
+ *
+ */
+inline size_t is_inside_rectangle_batch(const float *x, const float *y, size_t n, float field_max_x, float field_min_x, float field_max_y, float field_min_y, uint8_t *mask)
+{
+    return extended_math_kernels().rectangle[0](x, y, NULL, n, field_max_x, field_min_x, field_max_y, field_min_y, mask);
+}
+
+/**
+ * @brief Check which points are inside a triangle of any orientation, edges included.
+ *
+ * Uses the signs of the three edge functions instead of comparing areas.
+ *
+ * @param points The points.
+ * @param n The number of points.
+ * @param x1 The x coordinate of the first point of the triangle.
+ * @param y1 The y coordinate of the first point of the triangle.
+ * @param x2 The x coordinate of the second point of the triangle.
+ * @param y2 The y coordinate of the second point of the triangle.
+ * @param x3 The x coordinate of the third point of the triangle.
+ * @param y3 The y coordinate of the third point of the triangle.
+ * @param mask 1 for a point inside, 0 otherwise, n bytes.
+ * @return size_t The number of points inside.
+ */
+inline size_t check_point_is_inside_triangle_batch(const point2d_t *points, size_t n, float x1, float y1, float x2, float y2, float x3, float y3, uint8_t *mask)
+{
+    triangle_edges_t e = extended_math_triangle_edges(x1, y1, x2, y2, x3, y3);
+    return extended_math_kernels().triangle[1](NULL, NULL, points, n, e, mask);
+}
+
+/**
+ * @brief Check which points are inside a triangle, with the coordinates in separate arrays.
+ *
+ */
+inline size_t check_point_is_inside_triangle_batch(const float *x, const float *y, size_t n, float x1, float y1, float x2, float y2, float x3, float y3, uint8_t *mask)
+{
+    triangle_edges_t e = extended_math_triangle_edges(x1, y1, x2, y2, x3, y3);
+    return extended_math_kernels().triangle[0](x, y, NULL, n, e, mask);
+}
+
 #endif
\ No newline at end of file
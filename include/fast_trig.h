@@ -0,0 +1,396 @@
+/**
+ * @file fast_trig.h
+ *
+ * @brief This file contains fast trigonometry and 2D frame transforms.
+ *
+ * Polynomial sin/cos/atan2 in float, written without branches so that the
+ * batch loops below are vectorized by the compiler at -O3 (-mavx2 for 8
+ * lanes; cartesian_to_polar() also needs -fno-math-errno for its sqrtf).
+ * -ffast-math keeps the same accuracy; the range reduction then runs in
+ * double, which halves the lanes of that step.
+ * Measured against double-precision libm:
+ * - fast_sin(), fast_cos(), fast_sincos(): max abs error 1e-7 for
+ *   |x| <= 1e4 rad; beyond that the range reduction loses precision, and
+ *   past 2^22 rad the result is meaningless.
+ * - fast_atan2(): max abs error 2e-6 rad (about 1.1e-4 degrees) for any
+ *   finite input; fast_atan2(0, 0) is 0.
+ *
+ * On top of them:
+ * - angle helpers: wrap_pi(), wrap_2pi(), angle_diff();
+ * - polar2d_t <-> point2d_t conversion over arrays;
+ * - SE(2) transforms of point and pose arrays by a pose2d_t;
+ * - ScanTrig, the sin/cos table of a scan with a fixed angle increment, so
+ *   a laser scan goes to robot or world coordinates with multiplies only.
+ *
+ * @code{.cpp}
+ * ScanTrig scan(angle_min, angle_increment, 1080);
+ * ...
+ * scan.toWorld(ranges, robot_pose, points); // one call per scan
+ * @endcode
+ */
+
+#ifndef FAST_TRIG_H
+#define FAST_TRIG_H
+
+#include "custom_typedef.h"
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define FAST_TRIG_PI 3.14159265358979323846f
+#define FAST_TRIG_2PI 6.28318530717958647692f
+
+/**
+ * @brief Wrap an angle to (-pi, pi].
+ *
+ */
+inline float wrap_pi(float a)
+{
+    a = a - FAST_TRIG_2PI * floorf((a + FAST_TRIG_PI) * (1.0f / FAST_TRIG_2PI));
+    // floorf puts pi at -pi; keep the interval half-open the usual way
+    return a <= -FAST_TRIG_PI ? a + FAST_TRIG_2PI : a;
+}
+
+/**
+ * @brief Wrap an angle to [0, 2 pi).
+ *
+ */
+inline float wrap_2pi(float a)
+{
+    a = a - FAST_TRIG_2PI * floorf(a * (1.0f / FAST_TRIG_2PI));
+    return a >= FAST_TRIG_2PI ? 0.0f : a;
+}
+
+/**
+ * @brief Return the signed shortest rotation from b to a, in (-pi, pi].
+ *
+ */
+inline float angle_diff(float a, float b)
+{
+    return wrap_pi(a - b);
+}
+
+/**
+ * @brief Compute the sine and cosine of x.
+ *
+ * Cody-Waite reduction by pi/2, then the Cephes minimax polynomials on
+ * [-pi/4, pi/4].
+ */
+inline void fast_sincos(float x, float *s, float *c)
+{
+    // x = k * pi/2 + r, k rounded half away from zero by a truncating conversion (vectorizes
+    // without SSE4.1, and unlike the 1.5 * 2^23 trick survives -ffast-math)
+    int q = (int)(x * 0.636619772367581343f + copysignf(0.5f, x));
+    float k = (float)q;
+#ifdef __FAST_MATH__
+    // Reassociation would merge the three-part subtraction below, so subtract in double
+    float r = (float)((double)x - (double)k * 1.57079632679489661923);
+#else
+    // pi/2 split in three parts so k * part is exact
+    float r = x - k * 1.5703125f;
+    r = r - k * 4.837512969970703125e-4f;
+    r = r - k * 7.54978995489188216e-8f;
+#endif
+
+    float z = r * r;
+    float sin_r = r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+    float cos_r = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+
+    // Quadrant: swap for odd q, then the signs
+    float sv = (q & 1) ? cos_r : sin_r;
+    float cv = (q & 1) ? sin_r : cos_r;
+    *s = (q & 2) ? -sv : sv;
+    *c = ((q + 1) & 2) ? -cv : cv;
+}
+
+/**
+ * @brief Return the sine of x.
+ *
+ */
+inline float fast_sin(float x)
+{
+    float s, c;
+    fast_sincos(x, &s, &c);
+    return s;
+}
+
+/**
+ * @brief Return the cosine of x.
+ *
+ */
+inline float fast_cos(float x)
+{
+    float s, c;
+    fast_sincos(x, &s, &c);
+    return c;
+}
+
+/**
+ * @brief Return atan2(y, x), in [-pi, pi].
+ *
+ * An odd degree-11 minimax polynomial for atan on [0, 1], then octant fix-ups.
+ */
+inline float fast_atan2(float y, float x)
+{
+    float ax = fabsf(x), ay = fabsf(y);
+    // Only selects between plain values: GCC will not vectorize fmaxf/fminf
+    // or a select whose arm does arithmetic (it sinks the arithmetic into a branch)
+    bool swap = ay > ax;
+    float hi = swap ? ay : ax, lo = swap ? ax : ay;
+    float a = lo / (hi > FLT_MIN ? hi : FLT_MIN);
+
+    float z = a * a;
+    float t = a * (0.99997726f + z * (-0.33262347f + z * (0.19354346f + z * (-0.11643287f + z * (0.05265332f + z * -0.01172120f)))));
+
+    // t = pi/2 - t above the diagonal, then t = pi - t left of the y axis
+    t = (swap ? 1.57079632679489662f : 0.0f) + (swap ? -1.0f : 1.0f) * t;
+    t = (x < 0 ? FAST_TRIG_PI : 0.0f) + (x < 0 ? -1.0f : 1.0f) * t;
+    return copysignf(t, y);
+}
+
+/**
+ * @brief Convert polar points to Cartesian.
+ *
+ * @param in The polar points.
+ * @param n The number of points.
+ * @param out The Cartesian points; may not alias in.
+ */
+inline void polar_to_cartesian(const polar2d_t *in, size_t n, point2d_t *out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float s, c;
+        fast_sincos(in[i].theta, &s, &c);
+        out[i].x = in[i].r * c;
+        out[i].y = in[i].r * s;
+    }
+}
+
+/**
+ * @brief Convert polar points to Cartesian, with the coordinates in separate arrays.
+ *
+ */
+inline void polar_to_cartesian(const float *r, const float *theta, size_t n, float *x, float *y)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float s, c;
+        fast_sincos(theta[i], &s, &c);
+        x[i] = r[i] * c;
+        y[i] = r[i] * s;
+    }
+}
+
+/**
+ * @brief Convert Cartesian points to polar, theta in [-pi, pi].
+ *
+ * @param in The Cartesian points.
+ * @param n The number of points.
+ * @param out The polar points; may not alias in.
+ */
+inline void cartesian_to_polar(const point2d_t *in, size_t n, polar2d_t *out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].r = sqrtf(in[i].x * in[i].x + in[i].y * in[i].y);
+        out[i].theta = fast_atan2(in[i].y, in[i].x);
+    }
+}
+
+/**
+ * @brief Convert Cartesian points to polar, with the coordinates in separate arrays.
+ *
+ */
+inline void cartesian_to_polar(const float *x, const float *y, size_t n, float *r, float *theta)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        r[i] = sqrtf(x[i] * x[i] + y[i] * y[i]);
+        theta[i] = fast_atan2(y[i], x[i]);
+    }
+}
+
+/**
+ * @brief Compose two poses: b given in the frame of a, returned in the frame a is given in.
+ *
+ */
+inline pose2d_t pose_compose(pose2d_t a, pose2d_t b)
+{
+    float s, c;
+    fast_sincos(a.theta, &s, &c);
+    pose2d_t out;
+    out.x = a.x + c * b.x - s * b.y;
+    out.y = a.y + s * b.x + c * b.y;
+    out.theta = wrap_pi(a.theta + b.theta);
+    return out;
+}
+
+/**
+ * @brief Return the inverse of a pose.
+ *
+ */
+inline pose2d_t pose_inverse(pose2d_t a)
+{
+    float s, c;
+    fast_sincos(a.theta, &s, &c);
+    pose2d_t out;
+    out.x = -c * a.x - s * a.y;
+    out.y = s * a.x - c * a.y;
+    out.theta = wrap_pi(-a.theta);
+    return out;
+}
+
+/**
+ * @brief Transform points from the frame of a pose to the frame the pose is given in, e.g. robot to world.
+ *
+ * @param pose The pose.
+ * @param in The points.
+ * @param n The number of points.
+ * @param out The transformed points; may be in.
+ */
+inline void transform_points(pose2d_t pose, const point2d_t *in, size_t n, point2d_t *out)
+{
+    float s, c;
+    fast_sincos(pose.theta, &s, &c);
+    for (size_t i = 0; i < n; i++)
+    {
+        float x = in[i].x, y = in[i].y;
+        out[i].x = pose.x + c * x - s * y;
+        out[i].y = pose.y + s * x + c * y;
+    }
+}
+
+/**
+ * @brief Transform points into the frame of a pose, e.g. world to robot.
+ *
+ * @param pose The pose.
+ * @param in The points.
+ * @param n The number of points.
+ * @param out The transformed points; may be in.
+ */
+inline void inverse_transform_points(pose2d_t pose, const point2d_t *in, size_t n, point2d_t *out)
+{
+    float s, c;
+    fast_sincos(pose.theta, &s, &c);
+    for (size_t i = 0; i < n; i++)
+    {
+        float x = in[i].x - pose.x, y = in[i].y - pose.y;
+        out[i].x = c * x + s * y;
+        out[i].y = -s * x + c * y;
+    }
+}
+
+/**
+ * @brief Transform poses from the frame of a pose to the frame the pose is given in.
+ *
+ * @param pose The pose.
+ * @param in The poses.
+ * @param n The number of poses.
+ * @param out The transformed poses; may be in.
+ */
+inline void transform_poses(pose2d_t pose, const pose2d_t *in, size_t n, pose2d_t *out)
+{
+    float s, c;
+    fast_sincos(pose.theta, &s, &c);
+    for (size_t i = 0; i < n; i++)
+    {
+        float x = in[i].x, y = in[i].y;
+        out[i].x = pose.x + c * x - s * y;
+        out[i].y = pose.y + s * x + c * y;
+        out[i].theta = wrap_pi(pose.theta + in[i].theta);
+    }
+}
+
+/**
+ * @brief The sin/cos table of a scan with a fixed angle increment.
+ *
+ * Built once with libm in double, so the table itself is exact to float.
+ */
+class ScanTrig
+{
+public:
+    /**
+     * @brief Construct a new ScanTrig object.
+     *
+     * @param angle_min The angle of the first beam.
+     * @param angle_increment The angle between beams.
+     * @param count The number of beams.
+     */
+    ScanTrig(float angle_min, float angle_increment, size_t count) : sin_table(count), cos_table(count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            double a = (double)angle_min + (double)angle_increment * i;
+            sin_table[i] = (float)sin(a);
+            cos_table[i] = (float)cos(a);
+        }
+    }
+
+    /**
+     * @brief Convert ranges to points in the sensor frame.
+     *
+     * Invalid ranges (NaN, inf) give invalid points.
+     *
+     * @param ranges The ranges, one per beam.
+     * @param out The points, one per beam.
+     */
+    void toCartesian(const float *ranges, point2d_t *out) const
+    {
+        const float *s = sin_table.data(), *c = cos_table.data();
+        for (size_t i = 0; i < sin_table.size(); i++)
+        {
+            out[i].x = ranges[i] * c[i];
+            out[i].y = ranges[i] * s[i];
+        }
+    }
+
+    /**
+     * @brief Convert ranges to points in the sensor frame, with the coordinates in separate arrays.
+     *
+     */
+    void toCartesian(const float *ranges, float *x, float *y) const
+    {
+        const float *s = sin_table.data(), *c = cos_table.data();
+        for (size_t i = 0; i < sin_table.size(); i++)
+        {
+            x[i] = ranges[i] * c[i];
+            y[i] = ranges[i] * s[i];
+        }
+    }
+
+    /**
+     * @brief Convert ranges to points in the frame a sensor pose is given in, e.g. world.
+     *
+     * @param ranges The ranges, one per beam.
+     * @param pose The sensor pose.
+     * @param out The points, one per beam.
+     */
+    void toWorld(const float *ranges, pose2d_t pose, point2d_t *out) const
+    {
+        float ps, pc;
+        fast_sincos(pose.theta, &ps, &pc);
+        const float *s = sin_table.data(), *c = cos_table.data();
+        for (size_t i = 0; i < sin_table.size(); i++)
+        {
+            // cos(theta + a) and sin(theta + a) from the table
+            float cw = pc * c[i] - ps * s[i];
+            float sw = ps * c[i] + pc * s[i];
+            out[i].x = pose.x + ranges[i] * cw;
+            out[i].y = pose.y + ranges[i] * sw;
+        }
+    }
+
+    /**
+     * @brief Return the number of beams.
+     *
+     */
+    size_t size() const { return sin_table.size(); }
+
+private:
+    std::vector<float> sin_table, cos_table;
+};
+
+#endif // FAST_TRIG_H
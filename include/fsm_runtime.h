@@ -0,0 +1,473 @@
+/**
+ * @file fsm_runtime.h
+ *
+ * @brief This file contains the hierarchical FsmRuntime.
+ *
+ * FsmRuntime hosts many instances of one hierarchical state machine. The
+ * contexts and current states of all instances sit in contiguous arrays, other
+ * threads post events through one lock-free MpscQueue and every state timeout
+ * is a node in one shared TimerWheel, so tick() only touches the instances
+ * that actually have an event or an expired timer instead of polling a clock
+ * per instance like MachineState::timeout().
+ *
+ * States may have a parent. An event not handled by the current state bubbles
+ * up to its ancestors; the nearest ancestor with a transition for each
+ * [state][event] pair is resolved once, when the definition is built. A
+ * transition exits up to the least common ancestor of its source and target,
+ * runs its action, enters down to the target and then follows the initial
+ * children down to a leaf.
+ *
+ * @code{.cpp}
+ * enum { ON, IDLE, RUN, OFF, NUM_STATES };
+ * enum { EV_GO, EV_STOP, EV_POWER, EV_TIMEOUT, NUM_EVENTS };
+ *
+ * struct Agent { int runs; };
+ * void count_run(Agent &a) { a.runs++; }
+ *
+ * const HsmState<Agent> agent_states[] = {
+ *     // parent, initial child, entry, exit, timeout, timeout event
+ *     {-1, IDLE, NULL, NULL, 0, -1},             // ON
+ *     {ON, -1, NULL, NULL, 0, -1},               // IDLE
+ *     {ON, -1, count_run, NULL, 0.5f, EV_TIMEOUT}, // RUN, EV_TIMEOUT after 500 ms
+ *     {-1, -1, NULL, NULL, 0, -1},               // OFF
+ * };
+ * const FsmTransition<Agent> agent_transitions[] = {
+ *     // from, event, to (-1 for an internal transition), guard, action
+ *     {IDLE, EV_GO, RUN, NULL, NULL},
+ *     {RUN, EV_STOP, IDLE, NULL, NULL},
+ *     {RUN, EV_TIMEOUT, IDLE, NULL, NULL},
+ *     {ON, EV_POWER, OFF, NULL, NULL}, // handled in IDLE and RUN too
+ *     {OFF, EV_POWER, ON, NULL, NULL},
+ * };
+ * const HsmDefinition<Agent> agent_hsm(NUM_EVENTS, agent_states, agent_transitions);
+ *
+ * FsmRuntime<Agent> runtime(agent_hsm, 10000);
+ * Agent agent = {0};
+ * for (int i = 0; i < 10000; i++)
+ *     runtime.create(agent, ON);
+ * runtime.post(42, EV_GO);  // from any thread
+ * runtime.tick();           // once per cycle, on the owning thread
+ * @endcode
+ */
+
+#ifndef FSM_RUNTIME_H
+#define FSM_RUNTIME_H
+
+#include "custom_time.h"
+#include "static_fsm.h"
+#include "fsm_trace.h"
+#include "mpsc_queue.h"
+#include "timer_wheel.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief The deepest state nesting an HsmDefinition accepts.
+ *
+ */
+#define HSM_MAX_DEPTH 16
+
+/**
+ * @brief A state of a hierarchical machine.
+ *
+ * parent: the enclosing state, -1 for a top-level state.
+ * initial: the child entered when the state itself is the target, -1 for a leaf.
+ * timeout: after this many seconds in the state, timeout_event is dispatched; 0 disables it.
+ * An instance has one timer, owned by the innermost entered state with a timeout.
+ */
+template <class Context>
+struct HsmState
+{
+    int16_t parent;
+    int16_t initial;
+    void (*entry)(Context &);
+    void (*exit)(Context &);
+    float timeout;
+    int16_t timeout_event;
+};
+
+/**
+ * @brief A hierarchical machine definition with the event bubbling resolved.
+ *
+ * Transitions are FsmTransition (static_fsm.h); to = -1 makes an internal
+ * transition that runs the action without leaving the state.
+ *
+ * The constructor checks the definition, in release builds too: ids in
+ * range, an initial child that is a child of its state, and no parent cycle
+ * or nesting of HSM_MAX_DEPTH or more. A definition failing the check has
+ * valid set to false and FsmRuntime::create() refuses it.
+ */
+template <class Context>
+class HsmDefinition
+{
+public:
+    /**
+     * @brief Construct a new HsmDefinition object.
+     *
+     * @param num_events The number of events.
+     * @param states The states, indexed by state id.
+     * @param transitions The transitions; those sharing a (from, event) pair are tried in declaration order.
+     */
+    template <int S, int T>
+    HsmDefinition(int num_events, const HsmState<Context> (&states)[S], const FsmTransition<Context> (&transitions)[T])
+        : num_states(S), num_events(num_events),
+          states(states, states + S), transitions(transitions, transitions + T),
+          first(S * num_events, -1), next(T, -1), handler(S * num_events, -1),
+          depth(S, 0), timeout_ns(S, 0), valid(false)
+    {
+        if (!check(S, num_events, states, T, transitions))
+            return;
+
+        for (int t = T - 1; t >= 0; t--)
+        {
+            int16_t &head = first[transitions[t].from * num_events + transitions[t].event];
+            next[t] = head;
+            head = t;
+        }
+
+        for (int s = 0; s < S; s++)
+        {
+            timeout_ns[s] = (uint64_t)(states[s].timeout * 1.0e9);
+            for (int p = states[s].parent; p >= 0; p = states[p].parent)
+                depth[s]++;
+
+            // Nearest state, the state itself or an ancestor, handling each event
+            for (int e = 0; e < num_events; e++)
+                for (int p = s; p >= 0; p = states[p].parent)
+                    if (first[p * num_events + e] >= 0)
+                    {
+                        handler[s * num_events + e] = p;
+                        break;
+                    }
+        }
+        valid = true;
+    }
+
+    int num_states;
+    int num_events;
+    std::vector<HsmState<Context>> states;
+    std::vector<FsmTransition<Context>> transitions;
+
+    // First transition for [state][event] and the next one with the same pair, -1 for none
+    std::vector<int16_t> first;
+    std::vector<int16_t> next;
+
+    // Nearest state handling [state][event], -1 for none
+    std::vector<int16_t> handler;
+
+    std::vector<uint8_t> depth;
+    std::vector<uint64_t> timeout_ns;
+
+    // False if the constructor rejected the states or transitions
+    bool valid;
+
+private:
+    static bool check(int S, int num_events, const HsmState<Context> *states, int T, const FsmTransition<Context> *transitions)
+    {
+        if (num_events <= 0)
+            return false;
+        for (int s = 0; s < S; s++)
+        {
+            const HsmState<Context> &state = states[s];
+            if (state.parent < -1 || state.parent >= S || state.initial < -1 || state.initial >= S ||
+                state.timeout_event < -1 || state.timeout_event >= num_events)
+                return false;
+            if (state.initial >= 0 && states[state.initial].parent != s)
+                return false;
+
+            // Bounded, so a parent cycle ends here too
+            int n = 0;
+            for (int p = state.parent; p >= 0; p = states[p].parent)
+                if (++n >= HSM_MAX_DEPTH)
+                    return false;
+        }
+        for (int t = 0; t < T; t++)
+            if (transitions[t].from < 0 || transitions[t].from >= S || transitions[t].event < 0 ||
+                transitions[t].event >= num_events || transitions[t].to < -1 || transitions[t].to >= S)
+                return false;
+        return true;
+    }
+};
+
+/**
+ * @brief Many instances of one hierarchical state machine.
+ *
+ * post() may be called from any thread; everything else belongs to the thread calling tick().
+ *
+ * @tparam Context The per-instance object passed to guards, actions and hooks.
+ * @tparam Clock The clock used by the timers, see custom_time.h.
+ */
+template <class Context, class Clock = MonotonicClock>
+class FsmRuntime
+{
+public:
+    /**
+     * @brief Construct a new FsmRuntime object. Everything is allocated here.
+     *
+     * @param def The definition, it must outlive the runtime.
+     * @param capacity The maximum number of instances.
+     * @param queue_capacity The size of the posted event queue.
+     * @param timer_resolution_ns The timer wheel tick, 1 ms by default.
+     * @param timer_slots The number of timer wheel slots.
+     */
+    FsmRuntime(const HsmDefinition<Context> &def, uint32_t capacity, size_t queue_capacity = 4096,
+               uint64_t timer_resolution_ns = 1000000, uint32_t timer_slots = 1024)
+        : def(def), capacity(capacity), queue(queue_capacity),
+          wheel(timer_slots, timer_resolution_ns, Clock::now_ns()), timers(capacity), dropped_events(0)
+    {
+        contexts.reserve(capacity);
+        values.reserve(capacity);
+        now_ns = Clock::now_ns();
+    }
+
+    /**
+     * @brief Add an instance and enter its initial state, running the entry hooks.
+     *
+     * @param context The instance's context, copied.
+     * @param initial The initial state, followed down its initial children.
+     * @return int32_t The instance id, or -1 when the runtime is full, the initial state is out of range or the definition is not valid.
+     */
+    int32_t create(const Context &context, int16_t initial)
+    {
+        if (contexts.size() >= capacity || !def.valid || initial < 0 || initial >= def.num_states)
+            return -1;
+
+        uint32_t id = contexts.size();
+        contexts.push_back(context);
+        values.push_back(initial);
+        timers[id].id = id;
+
+        int16_t path[HSM_MAX_DEPTH];
+        int n = 0;
+        for (int16_t s = initial; s >= 0; s = def.states[s].parent)
+            path[n++] = s;
+        enterPath(id, path, n);
+        FSM_TRACE(id, -1, values[id], FSM_TRACE_INIT);
+        return id;
+    }
+
+    /**
+     * @brief Queue an event for an instance, callable from any thread.
+     *
+     * @param id The instance.
+     * @param event The event.
+     * @return bool False if the queue was full and the event was dropped.
+     */
+    bool post(uint32_t id, int16_t event)
+    {
+        QueuedEvent queued = {id, event};
+        if (queue.push(queued))
+            return true;
+        dropped_events.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * @brief Deliver an event to an instance immediately, from the tick() thread.
+     *
+     * @param id The instance.
+     * @param event The event.
+     * @return bool True if a transition was taken.
+     */
+    bool dispatch(uint32_t id, int16_t event)
+    {
+        if ((uint16_t)event >= (uint16_t)def.num_events)
+            return false;
+
+        const int E = def.num_events;
+        int16_t source = def.handler[values[id] * E + event];
+        while (source >= 0)
+        {
+            for (int i = def.first[source * E + event]; i >= 0; i = def.next[i])
+            {
+                const FsmTransition<Context> &tr = def.transitions[i];
+                if (tr.guard == NULL || tr.guard(contexts[id]))
+                {
+                    if (tr.to < 0)
+                    {
+                        if (tr.action)
+                            tr.action(contexts[id]);
+                    }
+                    else
+                        transit(id, source, tr.to, tr.action, event);
+                    return true;
+                }
+            }
+
+            // Every guard failed, keep bubbling
+            int16_t parent = def.states[source].parent;
+            source = parent >= 0 ? def.handler[parent * E + event] : -1;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Fire the expired timers, then deliver the queued events. Call it once per cycle.
+     *
+     * Events posted while tick() runs wait for the next tick().
+     */
+    void tick()
+    {
+        tick(Clock::now_ns());
+    }
+
+    /**
+     * @brief tick() at a given time.
+     *
+     * @param t_ns The current time in nanoseconds.
+     */
+    void tick(uint64_t t_ns)
+    {
+        now_ns = t_ns;
+        wheel.advance(t_ns, [this](TimerNode *node)
+                      { dispatch(node->id, def.states[node->tag].timeout_event); });
+
+        QueuedEvent queued;
+        for (size_t n = queue.capacity(); n > 0 && queue.pop(queued); n--)
+            if (queued.id < contexts.size())
+                dispatch(queued.id, queued.event);
+    }
+
+    /**
+     * @brief Force an instance into a state, running the exit and entry hooks.
+     *
+     * @param id The instance.
+     * @param target The new state, followed down its initial children.
+     */
+    void set(uint32_t id, int16_t target)
+    {
+        transit(id, values[id], target, NULL, FSM_TRACE_SET);
+    }
+
+    /**
+     * @brief Return the current (leaf) state of an instance.
+     *
+     */
+    int16_t state(uint32_t id) const { return values[id]; }
+
+    /**
+     * @brief Check whether an instance is in a state or one of its children.
+     *
+     */
+    bool isIn(uint32_t id, int16_t s) const
+    {
+        for (int16_t p = values[id]; p >= 0; p = def.states[p].parent)
+            if (p == s)
+                return true;
+        return false;
+    }
+
+    /**
+     * @brief Return the context of an instance.
+     *
+     */
+    Context &context(uint32_t id) { return contexts[id]; }
+    const Context &context(uint32_t id) const { return contexts[id]; }
+
+    /**
+     * @brief Return the number of instances.
+     *
+     */
+    uint32_t size() const { return contexts.size(); }
+
+    /**
+     * @brief Return the number of events dropped because the queue was full.
+     *
+     */
+    uint64_t dropped() const { return dropped_events.load(std::memory_order_relaxed); }
+
+private:
+    struct QueuedEvent
+    {
+        uint32_t id;
+        int16_t event;
+    };
+
+    void transit(uint32_t id, int16_t source, int16_t target, void (*action)(Context &), int16_t cause)
+    {
+        int16_t from = values[id];
+        const std::vector<HsmState<Context>> &states = def.states;
+
+        // Least common ancestor; a transition to or from an ancestor leaves and re-enters it
+        int16_t a = source, b = target;
+        while (def.depth[a] > def.depth[b])
+            a = states[a].parent;
+        while (def.depth[b] > def.depth[a])
+            b = states[b].parent;
+        while (a != b)
+        {
+            a = states[a].parent;
+            b = states[b].parent;
+        }
+        int16_t lca = a;
+        if (lca == source || lca == target)
+            lca = states[lca].parent;
+
+        for (int16_t s = values[id]; s != lca; s = states[s].parent)
+            exitState(id, s);
+
+        if (action)
+            action(contexts[id]);
+
+        int16_t path[HSM_MAX_DEPTH];
+        int n = 0;
+        for (int16_t s = target; s != lca; s = states[s].parent)
+            path[n++] = s;
+        enterPath(id, path, n);
+        FSM_TRACE(id, from, values[id], cause);
+    }
+
+    // Enter path[n-1] .. path[0], then the initial children below path[0]
+    void enterPath(uint32_t id, const int16_t *path, int n)
+    {
+        int16_t s = -1;
+        for (int i = n - 1; i >= 0; i--)
+        {
+            s = path[i];
+            enterState(id, s);
+        }
+        while (def.states[s].initial >= 0)
+        {
+            s = def.states[s].initial;
+            enterState(id, s);
+        }
+        values[id] = s;
+    }
+
+    void enterState(uint32_t id, int16_t s)
+    {
+        if (def.timeout_ns[s])
+        {
+            timers[id].tag = s;
+            wheel.schedule(&timers[id], now_ns + def.timeout_ns[s]);
+        }
+        if (def.states[s].entry)
+            def.states[s].entry(contexts[id]);
+    }
+
+    void exitState(uint32_t id, int16_t s)
+    {
+        if (timers[id].armed && timers[id].tag == s)
+            wheel.cancel(&timers[id]);
+        if (def.states[s].exit)
+            def.states[s].exit(contexts[id]);
+    }
+
+    const HsmDefinition<Context> &def;
+    uint32_t capacity;
+
+    // Per instance, indexed by id
+    std::vector<Context> contexts;
+    std::vector<int16_t> values;
+
+    MpscQueue<QueuedEvent> queue;
+    TimerWheel wheel;
+    std::vector<TimerNode> timers;
+    uint64_t now_ns;
+    std::atomic<uint64_t> dropped_events;
+};
+
+#endif // FSM_RUNTIME_H
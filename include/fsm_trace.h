@@ -0,0 +1,366 @@
+/**
+ * @file fsm_trace.h
+ *
+ * @brief This file contains the state machine transition tracer.
+ *
+ * Every thread records into its own fixed-size ring of 24 byte binary records
+ * (time, machine id, from, to, cause). Recording is a TSC read and a few
+ * stores with no lock, no formatting and no system call; the oldest records
+ * are overwritten when the ring is full. fsm_trace_dump() merges the rings of
+ * all threads into a binary file and fsm_trace_decode() (or the
+ * tools/fsm_trace_decode program) turns it into text or CSV offline.
+ *
+ * Tracing is opt-in: the FSM_TRACE() hooks in MachineState, StaticMachine and
+ * FsmRuntime compile to nothing unless RD_KITS_FSM_TRACE is defined before
+ * including them. MachineState records set(), timeout() and reentry();
+ * assigning its value directly is not recorded.
+ *
+ * @code{.cpp}
+ * #define RD_KITS_FSM_TRACE
+ * #include "rd-kits.h"
+ *
+ * fsm_trace_init(); // per tracing thread, at startup
+ * MachineState machine;
+ * machine.trace_id = 7;
+ * machine.set(RUNNING); // traced, unlike machine.value = RUNNING
+ * ...
+ * fsm_trace_dump("fsm.trace"); // e.g. in a fault handler, then: fsm_trace_decode fsm.trace --csv
+ * @endcode
+ */
+
+#ifndef FSM_TRACE_H
+#define FSM_TRACE_H
+
+#include "custom_time.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The number of records kept per thread, a power of two.
+ *
+ */
+#ifndef FSM_TRACE_CAPACITY
+#define FSM_TRACE_CAPACITY 4096
+#endif
+
+/**
+ * @brief Record a transition when RD_KITS_FSM_TRACE is defined, nothing otherwise.
+ *
+ */
+#ifdef RD_KITS_FSM_TRACE
+#define FSM_TRACE(machine, from, to, cause) fsm_trace((machine), (from), (to), (cause))
+#else
+#define FSM_TRACE(machine, from, to, cause) ((void)sizeof(machine), (void)sizeof(from), (void)sizeof(to), (void)sizeof(cause))
+#endif
+
+/**
+ * @brief Causes that are not an event; an event cause is the event id itself (>= 0).
+ *
+ */
+enum FsmTraceCause
+{
+    FSM_TRACE_INIT = -1,    // initial state entered
+    FSM_TRACE_SET = -2,     // state forced by set()
+    FSM_TRACE_TIMEOUT = -3, // timeout expired
+    FSM_TRACE_REENTRY = -4  // reentry period missed
+};
+
+/**
+ * @brief One traced transition.
+ *
+ */
+typedef struct
+{
+    uint64_t t_ns;    // TscClock time
+    uint32_t machine; // machine id, e.g. MachineState::trace_id or the FsmRuntime instance
+    int16_t from;
+    int16_t to;
+    int16_t cause;    // event id or FsmTraceCause
+    uint16_t thread;  // recording thread, in registration order
+    uint32_t reserved;
+} fsm_trace_record_t;
+
+static_assert(sizeof(fsm_trace_record_t) == 24, "fsm_trace_record_t must stay 24 bytes");
+static_assert(sizeof(fsm_trace_record_t) % sizeof(uint64_t) == 0, "fsm_trace_record_t must be whole 64-bit words");
+static_assert((FSM_TRACE_CAPACITY & (FSM_TRACE_CAPACITY - 1)) == 0, "FSM_TRACE_CAPACITY must be a power of two");
+
+/**
+ * @brief The header of a dump file, followed by count records sorted by time.
+ *
+ */
+typedef struct
+{
+    char magic[8]; // "RDFSMTRC"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t dropped; // records overwritten before the dump
+} fsm_trace_file_t;
+
+/**
+ * @brief The words of a record in the ring, stored as relaxed atomics so a reader may copy them while the thread writes.
+ *
+ */
+#define FSM_TRACE_WORDS (sizeof(fsm_trace_record_t) / sizeof(uint64_t))
+
+/**
+ * @brief The ring of one thread, a seqlock per slot. Only its thread writes.
+ *
+ * The writer bumps claim before it touches a slot (with a release fence in
+ * between) and publishes the record with head. A reader copies the slots,
+ * then an acquire fence, then loads claim: any slot whose copy may hold
+ * part of a later write is covered by that claim.
+ */
+struct FsmTraceRing
+{
+    std::atomic<uint64_t> claim; // records started
+    std::atomic<uint64_t> head;  // records finished
+    uint16_t thread;
+    std::atomic<uint64_t> records[FSM_TRACE_CAPACITY][FSM_TRACE_WORDS];
+};
+
+/**
+ * @brief The rings of every thread that has traced. Rings are never freed, so a dump still sees threads that exited.
+ *
+ */
+struct FsmTraceRegistry
+{
+    std::mutex mutex;
+    std::vector<FsmTraceRing *> rings;
+};
+
+inline FsmTraceRegistry &fsm_trace_registry()
+{
+    static FsmTraceRegistry registry;
+    return registry;
+}
+
+inline FsmTraceRing *fsm_trace_register()
+{
+    // calibrate the TSC here, with the allocation, not on a traced transition
+    TscClock::available();
+
+    FsmTraceRing *ring = new FsmTraceRing;
+    ring->claim.store(0, std::memory_order_relaxed);
+    ring->head.store(0, std::memory_order_relaxed);
+
+    FsmTraceRegistry &registry = fsm_trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ring->thread = registry.rings.size();
+    registry.rings.push_back(ring);
+    return ring;
+}
+
+/**
+ * @brief Return the ring of the calling thread, registered on first use.
+ *
+ */
+inline FsmTraceRing &fsm_trace_ring()
+{
+    static thread_local FsmTraceRing *ring = fsm_trace_register();
+    return *ring;
+}
+
+/**
+ * @brief Register the calling thread's ring ahead of time.
+ *
+ * The first trace of a thread allocates its ring, and the first trace of the
+ * process calibrates TscClock (a 10 ms busy-wait). Call this once per
+ * tracing thread at startup to keep both out of the control loop.
+ */
+inline void fsm_trace_init()
+{
+    fsm_trace_ring();
+}
+
+/**
+ * @brief Record a transition on the calling thread. Prefer the FSM_TRACE() macro.
+ *
+ * @param machine The machine id.
+ * @param from The state left.
+ * @param to The state entered.
+ * @param cause The event id or an FsmTraceCause.
+ */
+inline void fsm_trace(uint32_t machine, int16_t from, int16_t to, int16_t cause)
+{
+    FsmTraceRing &ring = fsm_trace_ring();
+    fsm_trace_record_t r;
+    r.t_ns = TscClock::now_ns();
+    r.machine = machine;
+    r.from = from;
+    r.to = to;
+    r.cause = cause;
+    r.thread = ring.thread;
+    r.reserved = 0;
+    uint64_t words[FSM_TRACE_WORDS];
+    memcpy(words, &r, sizeof(r));
+
+    uint64_t h = ring.head.load(std::memory_order_relaxed);
+    ring.claim.store(h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic<uint64_t> *slot = ring.records[h & (FSM_TRACE_CAPACITY - 1)];
+    for (size_t w = 0; w < FSM_TRACE_WORDS; w++)
+        slot[w].store(words[w], std::memory_order_relaxed);
+    ring.head.store(h + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Copy the records of every thread, oldest first, while the threads keep tracing.
+ *
+ * Records a writer may have overwritten during the copy are discarded, see FsmTraceRing.
+ *
+ * @param records The records, replaced.
+ * @return uint64_t The number of records lost to ring overwrites.
+ */
+inline uint64_t fsm_trace_snapshot(std::vector<fsm_trace_record_t> &records)
+{
+    records.clear();
+    uint64_t dropped = 0;
+
+    FsmTraceRegistry &registry = fsm_trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t i = 0; i < registry.rings.size(); i++)
+    {
+        FsmTraceRing &ring = *registry.rings[i];
+        uint64_t end = ring.head.load(std::memory_order_acquire);
+        uint64_t begin = end > FSM_TRACE_CAPACITY ? end - FSM_TRACE_CAPACITY : 0;
+
+        size_t base = records.size();
+        for (uint64_t h = begin; h < end; h++)
+        {
+            uint64_t words[FSM_TRACE_WORDS];
+            const std::atomic<uint64_t> *slot = ring.records[h & (FSM_TRACE_CAPACITY - 1)];
+            for (size_t w = 0; w < FSM_TRACE_WORDS; w++)
+                words[w] = slot[w].load(std::memory_order_relaxed);
+            fsm_trace_record_t r;
+            memcpy(&r, words, sizeof(r));
+            records.push_back(r);
+        }
+
+        // Drop what the writer may have reused while we copied: a write that
+        // reached our copy claimed its slot before the fence pairs with ours
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t claimed = ring.claim.load(std::memory_order_relaxed);
+        uint64_t valid = claimed > FSM_TRACE_CAPACITY ? claimed - FSM_TRACE_CAPACITY : 0;
+        if (valid > begin)
+        {
+            size_t lost = std::min(valid, end) - begin;
+            records.erase(records.begin() + base, records.begin() + base + lost);
+            begin += lost;
+        }
+        dropped += begin;
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+                     [](const fsm_trace_record_t &a, const fsm_trace_record_t &b)
+                     { return a.t_ns < b.t_ns; });
+    return dropped;
+}
+
+/**
+ * @brief Write the records of every thread to a binary file.
+ *
+ * @param path The file path.
+ * @return long The number of records written, -1 on error.
+ */
+inline long fsm_trace_dump(const char *path)
+{
+    std::vector<fsm_trace_record_t> records;
+    fsm_trace_file_t header;
+    memcpy(header.magic, "RDFSMTRC", 8);
+    header.version = 1;
+    header.record_size = sizeof(fsm_trace_record_t);
+    header.dropped = fsm_trace_snapshot(records);
+    header.count = records.size();
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+        return -1;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(records.data(), sizeof(fsm_trace_record_t), records.size(), f) == records.size();
+    ok = fclose(f) == 0 && ok;
+    return ok ? (long)records.size() : -1;
+}
+
+/**
+ * @brief Return the name of a cause, or NULL for an event.
+ *
+ */
+inline const char *fsm_trace_cause_name(int16_t cause)
+{
+    switch (cause)
+    {
+    case FSM_TRACE_INIT:
+        return "init";
+    case FSM_TRACE_SET:
+        return "set";
+    case FSM_TRACE_TIMEOUT:
+        return "timeout";
+    case FSM_TRACE_REENTRY:
+        return "reentry";
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief Decode a dump file to text or CSV.
+ *
+ * Times are printed in seconds relative to the first record.
+ *
+ * @param path The dump file path.
+ * @param out The output stream.
+ * @param csv True for CSV with a header row, false for aligned text.
+ * @return long The number of records decoded, -1 if the file is not a valid dump.
+ */
+inline long fsm_trace_decode(const char *path, FILE *out, bool csv)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    fsm_trace_file_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "RDFSMTRC", 8) != 0 ||
+        header.version != 1 || header.record_size != sizeof(fsm_trace_record_t))
+    {
+        fclose(f);
+        return -1;
+    }
+
+    if (csv)
+        fprintf(out, "t_s,thread,machine,from,to,cause\n");
+    else
+        fprintf(out, "# %llu records, %llu overwritten before the dump\n",
+                (unsigned long long)header.count, (unsigned long long)header.dropped);
+
+    long n = 0;
+    uint64_t t0 = 0;
+    fsm_trace_record_t r;
+    while (fread(&r, sizeof(r), 1, f) == 1)
+    {
+        if (n == 0)
+            t0 = r.t_ns;
+        double t = (double)(r.t_ns - t0) * 1.0e-9;
+        const char *name = fsm_trace_cause_name(r.cause);
+        char cause[16];
+        if (name == NULL)
+            snprintf(cause, sizeof(cause), "event %d", r.cause);
+
+        if (csv)
+            fprintf(out, "%.9f,%u,%u,%d,%d,%s\n", t, r.thread, r.machine, r.from, r.to, name ? name : cause + 6);
+        else
+            fprintf(out, "%14.9f  thread %-3u machine %-6u %5d -> %-5d %s\n", t, r.thread, r.machine, r.from, r.to, name ? name : cause);
+        n++;
+    }
+
+    fclose(f);
+    return n;
+}
+
+#endif // FSM_TRACE_H
@@ -3,34 +3,590 @@
  *
  * @brief This file contains keyboard input functions.
  *
- * This file contains keyboard input functions.
+ * KeyboardInput reads a file descriptor (standard input by default) on its
+ * own thread, waiting in poll() instead of being polled, decodes the bytes
+ * into key events (arrows, function keys and other escape sequences, with
+ * their modifiers, and UTF-8 characters) and hands them to the control loop
+ * through a lock-free SpscQueue, so draining keys costs no system call. On a
+ * terminal the input is switched to non-canonical, no-echo mode and restored
+ * on stop(), on exit and on fatal signals. Pipes and ptys work too, so
+ * scripted input can drive it headlessly.
+ *
+ * @code{.cpp}
+ * KeyboardInput keyboard;
+ * keyboard.start();
+ * while (running)
+ * {
+ *     key_event_t ev;
+ *     while (keyboard.poll(ev))
+ *         if (ev.key == KB_UP)
+ *             speed += 0.1;
+ *     ...
+ * }
+ * @endcode
  */
 
 #ifndef KEYBOARD_INPUT_H
 #define KEYBOARD_INPUT_H
 
+#include "custom_time.h"
+#include "spsc_queue.h"
+
 #include "stdio.h"
 #include "sys/ioctl.h"
 #include "termios.h"
 
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief Key codes. Characters are their Unicode code point, special keys start at KB_SPECIAL.
+ *
+ */
+enum KeyCode
+{
+    KB_NONE = 0,
+    KB_TAB = 9,
+    KB_ENTER = 10,
+    KB_ESCAPE = 27,
+    KB_BACKSPACE = 127,
+    KB_SPECIAL = 0x110000,
+    KB_UP = KB_SPECIAL,
+    KB_DOWN,
+    KB_RIGHT,
+    KB_LEFT,
+    KB_HOME,
+    KB_END,
+    KB_INSERT,
+    KB_DELETE,
+    KB_PAGE_UP,
+    KB_PAGE_DOWN,
+    KB_F1,
+    KB_F2,
+    KB_F3,
+    KB_F4,
+    KB_F5,
+    KB_F6,
+    KB_F7,
+    KB_F8,
+    KB_F9,
+    KB_F10,
+    KB_F11,
+    KB_F12,
+    KB_UNKNOWN // an escape sequence that was not recognized
+};
+
+/* MODIFIER DEFINITIONS */
+#define KB_MOD_SHIFT 0x01
+#define KB_MOD_ALT 0x02
+#define KB_MOD_CTRL 0x04
+
+/**
+ * @brief One key press.
+ *
+ */
+typedef struct
+{
+    uint64_t t_ns;     // MonotonicClock time the bytes were read
+    int32_t key;       // KeyCode or code point; Ctrl+letter arrives as its control character (1..26)
+    uint8_t modifiers; // KB_MOD_*
+} key_event_t;
+
+/**
+ * @brief A decoder turning terminal input bytes into key events.
+ *
+ */
+class KeyDecoder
+{
+public:
+    KeyDecoder() : state(GROUND), length(0), utf8_left(0), codepoint(0) {}
+
+    /**
+     * @brief Feed one byte.
+     *
+     * @param c The byte.
+     * @param t_ns The time it was read.
+     * @param emit Called as emit(const key_event_t &) for every complete key.
+     */
+    template <class Emit>
+    void feed(uint8_t c, uint64_t t_ns, Emit &&emit)
+    {
+        switch (state)
+        {
+        case GROUND:
+            if (c == 0x1b)
+            {
+                state = ESCAPE;
+                length = 0;
+            }
+            else
+                text(c, 0, t_ns, emit);
+            break;
+
+        case ESCAPE:
+            if (c == '[')
+                state = CSI;
+            else if (c == 'O')
+                state = SS3;
+            else if (c == 0x1b)
+                send(KB_ESCAPE, 0, t_ns, emit); // stay in ESCAPE for the second one
+            else
+            {
+                state = GROUND;
+                text(c, KB_MOD_ALT, t_ns, emit);
+            }
+            break;
+
+        case SS3:
+            state = GROUND;
+            send(ss3(c), 0, t_ns, emit);
+            break;
+
+        case CSI:
+            if (c >= 0x40 && c <= 0x7e)
+            {
+                state = GROUND;
+                csi(c, t_ns, emit);
+            }
+            else if (length < sizeof(params) - 1)
+                params[length++] = c;
+            break;
+        }
+    }
+
+    /**
+     * @brief Emit a lone ESC still waiting for the rest of a sequence.
+     *
+     * Call it when no byte arrived for a while after an ESC, KeyboardInput waits 30 ms.
+     */
+    template <class Emit>
+    void flush(uint64_t t_ns, Emit &&emit)
+    {
+        if (state == ESCAPE)
+            send(KB_ESCAPE, 0, t_ns, emit);
+        state = GROUND;
+    }
+
+    /**
+     * @brief Check if a sequence is incomplete.
+     *
+     */
+    bool pending() const { return state != GROUND; }
+
+private:
+    enum State
+    {
+        GROUND,
+        ESCAPE,
+        CSI,
+        SS3
+    };
+
+    template <class Emit>
+    static void send(int32_t key, uint8_t modifiers, uint64_t t_ns, Emit &emit)
+    {
+        key_event_t ev;
+        ev.t_ns = t_ns;
+        ev.key = key;
+        ev.modifiers = modifiers;
+        emit(ev);
+    }
+
+    // Plain bytes, assembling UTF-8
+    template <class Emit>
+    void text(uint8_t c, uint8_t modifiers, uint64_t t_ns, Emit &emit)
+    {
+        if (utf8_left && (c & 0xc0) == 0x80)
+        {
+            codepoint = (codepoint << 6) | (c & 0x3f);
+            if (--utf8_left == 0)
+                send(codepoint, modifiers, t_ns, emit);
+            return;
+        }
+        utf8_left = 0;
+
+        if (c < 0x80)
+        {
+            int32_t key = c;
+            if (c == '\r')
+                key = KB_ENTER;
+            else if (c == 8)
+                key = KB_BACKSPACE;
+            send(key, modifiers, t_ns, emit);
+        }
+        else if ((c & 0xe0) == 0xc0)
+        {
+            codepoint = c & 0x1f;
+            utf8_left = 1;
+        }
+        else if ((c & 0xf0) == 0xe0)
+        {
+            codepoint = c & 0x0f;
+            utf8_left = 2;
+        }
+        else if ((c & 0xf8) == 0xf0)
+        {
+            codepoint = c & 0x07;
+            utf8_left = 3;
+        }
+    }
+
+    static int32_t ss3(uint8_t c)
+    {
+        switch (c)
+        {
+        case 'A':
+            return KB_UP;
+        case 'B':
+            return KB_DOWN;
+        case 'C':
+            return KB_RIGHT;
+        case 'D':
+            return KB_LEFT;
+        case 'H':
+            return KB_HOME;
+        case 'F':
+            return KB_END;
+        case 'P':
+            return KB_F1;
+        case 'Q':
+            return KB_F2;
+        case 'R':
+            return KB_F3;
+        case 'S':
+            return KB_F4;
+        default:
+            return KB_UNKNOWN;
+        }
+    }
+
+    // ESC [ p1 ; p2 final, where p2 - 1 is the xterm modifier mask
+    template <class Emit>
+    void csi(uint8_t final, uint64_t t_ns, Emit &emit)
+    {
+        int p[2] = {0, 0};
+        int n = 0;
+        for (size_t i = 0; i < length && n < 2; i++)
+        {
+            if (params[i] >= '0' && params[i] <= '9')
+                p[n] = p[n] * 10 + (params[i] - '0');
+            else if (params[i] == ';')
+                n++;
+        }
+        uint8_t modifiers = p[1] > 1 ? (uint8_t)((p[1] - 1) & 0x07) : 0;
+
+        int32_t key = KB_UNKNOWN;
+        if (final == '~')
+        {
+            static const int32_t tilde[] = {
+                KB_UNKNOWN, KB_HOME, KB_INSERT, KB_DELETE, KB_END, KB_PAGE_UP, KB_PAGE_DOWN, KB_HOME, KB_END, KB_UNKNOWN,
+                KB_UNKNOWN, KB_F1, KB_F2, KB_F3, KB_F4, KB_F5, KB_UNKNOWN, KB_F6, KB_F7, KB_F8,
+                KB_F9, KB_F10, KB_UNKNOWN, KB_F11, KB_F12};
+            if (p[0] >= 0 && p[0] < (int)(sizeof(tilde) / sizeof(tilde[0])))
+                key = tilde[p[0]];
+        }
+        else if (final == 'Z')
+        {
+            key = KB_TAB;
+            modifiers |= KB_MOD_SHIFT;
+        }
+        else
+            key = ss3(final);
+        send(key, modifiers, t_ns, emit);
+    }
+
+    State state;
+    char params[16];
+    size_t length;
+    int utf8_left;
+    int32_t codepoint;
+};
+
+/**
+ * @brief The terminal settings to restore, shared by KeyboardInput, kbhit() and the exit and signal handlers.
+ *
+ */
+struct KeyboardTerminal
+{
+    int fd;
+    termios saved;
+    volatile sig_atomic_t active;
+    struct sigaction previous[NSIG];
+    bool hooked;
+};
+
+inline KeyboardTerminal &keyboard_terminal()
+{
+    static KeyboardTerminal terminal = {-1, termios(), 0, {}, false};
+    return terminal;
+}
+
+/**
+ * @brief Put the saved terminal settings back, safe to call from a signal handler.
+ *
+ */
+inline void keyboard_terminal_restore()
+{
+    KeyboardTerminal &terminal = keyboard_terminal();
+    if (terminal.active)
+    {
+        tcsetattr(terminal.fd, TCSANOW, &terminal.saved);
+        terminal.active = 0;
+    }
+}
+
+inline void keyboard_terminal_at_exit()
+{
+    keyboard_terminal_restore();
+}
+
+inline void keyboard_terminal_signal(int sig)
+{
+    keyboard_terminal_restore();
+
+    // Put back what was installed before and deliver the signal to it once this handler returns
+    KeyboardTerminal &terminal = keyboard_terminal();
+    sigaction(sig, &terminal.previous[sig], NULL);
+    if (terminal.previous[sig].sa_handler != SIG_IGN)
+        raise(sig);
+}
+
+/**
+ * @brief Switch a terminal to non-canonical, no-echo input, restored at exit and on fatal signals.
+ *
+ * @param fd The terminal.
+ * @param echo Keep echo on, like the original kbhit().
+ * @return bool False if fd is not a terminal, or another one is already switched.
+ */
+inline bool keyboard_terminal_raw(int fd, bool echo)
+{
+    KeyboardTerminal &terminal = keyboard_terminal();
+    if (terminal.active || !isatty(fd))
+        return false;
+
+    termios term;
+    if (tcgetattr(fd, &term) != 0)
+        return false;
+    terminal.fd = fd;
+    terminal.saved = term;
+
+    term.c_lflag &= ~ICANON;
+    if (!echo)
+        term.c_lflag &= ~ECHO;
+    term.c_cc[VMIN] = 1;
+    term.c_cc[VTIME] = 0;
+
+    if (!terminal.hooked)
+    {
+        atexit(keyboard_terminal_at_exit);
+        static const int signals[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGABRT, SIGSEGV};
+        for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+        {
+            struct sigaction sa;
+            sa.sa_handler = keyboard_terminal_signal;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_RESETHAND;
+            sigaction(signals[i], &sa, &terminal.previous[signals[i]]);
+        }
+        terminal.hooked = true;
+    }
+
+    terminal.active = 1;
+    if (tcsetattr(fd, TCSANOW, &term) != 0)
+    {
+        terminal.active = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Keyboard input read on a background thread.
+ *
+ */
+class KeyboardInput
+{
+public:
+    /**
+     * @brief Construct a new KeyboardInput object.
+     *
+     * @param fd The input, standard input by default; a pipe or pty works too.
+     * @param queue_size The number of keys buffered for poll().
+     */
+    KeyboardInput(int fd = STDIN_FILENO, size_t queue_size = 256)
+        : fd(fd), queue(queue_size), running(false), closed(false), dropped_keys(0), raw(false)
+    {
+        wake[0] = wake[1] = -1;
+    }
+
+    /**
+     * @brief Stop the reader and restore the terminal.
+     *
+     */
+    ~KeyboardInput()
+    {
+        stop();
+    }
+
+    KeyboardInput(const KeyboardInput &) = delete;
+    KeyboardInput &operator=(const KeyboardInput &) = delete;
+
+    /**
+     * @brief Start the reader thread, switching a terminal to non-canonical, no-echo input.
+     *
+     * @return bool False if it is already running or the wake-up pipe cannot be made.
+     */
+    bool start()
+    {
+        if (running.load())
+            return false;
+        if (pipe(wake) != 0)
+            return false;
+        fcntl(wake[0], F_SETFL, O_NONBLOCK);
+
+        raw = keyboard_terminal_raw(fd, false);
+        closed.store(false);
+        running.store(true);
+        thread = std::thread(&KeyboardInput::work, this);
+        return true;
+    }
+
+    /**
+     * @brief Stop the reader thread and restore the terminal.
+     *
+     */
+    void stop()
+    {
+        if (running.exchange(false))
+        {
+            char c = 0;
+            if (write(wake[1], &c, 1) < 0)
+                perror("KeyboardInput");
+            thread.join();
+        }
+        if (wake[0] >= 0)
+        {
+            close(wake[0]);
+            close(wake[1]);
+            wake[0] = wake[1] = -1;
+        }
+        if (raw)
+        {
+            keyboard_terminal_restore();
+            raw = false;
+        }
+    }
+
+    /**
+     * @brief Take the next key, without a system call.
+     *
+     * @param ev The key, written on success.
+     * @return bool False if no key is waiting.
+     */
+    bool poll(key_event_t &ev)
+    {
+        return queue.pop(ev);
+    }
+
+    /**
+     * @brief Check if the input reached end of file, e.g. the writing end of a pipe closed.
+     *
+     */
+    bool eof() const { return closed.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Return the number of keys lost because poll() was not called often enough.
+     *
+     */
+    uint64_t dropped() const { return dropped_keys.load(std::memory_order_relaxed); }
+
+private:
+    // Milliseconds to wait after ESC before taking it as the Escape key
+    static constexpr int ESCAPE_TIMEOUT_MS = 30;
+
+    void work()
+    {
+        KeyDecoder decoder;
+        auto emit = [this](const key_event_t &ev)
+        {
+            if (!queue.push(ev))
+                dropped_keys.fetch_add(1, std::memory_order_relaxed);
+        };
+
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake[0];
+        fds[1].events = POLLIN;
+
+        uint8_t buffer[64];
+        while (running.load(std::memory_order_relaxed))
+        {
+            int ready = ::poll(fds, 2, decoder.pending() ? ESCAPE_TIMEOUT_MS : -1);
+            if (ready < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (ready == 0)
+            {
+                decoder.flush(MonotonicClock::now_ns(), emit);
+                continue;
+            }
+            if (fds[1].revents)
+                break;
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                    continue;
+                if (n <= 0)
+                {
+                    decoder.flush(MonotonicClock::now_ns(), emit);
+                    closed.store(true, std::memory_order_release);
+                    break;
+                }
+                uint64_t t_now = MonotonicClock::now_ns();
+                for (ssize_t i = 0; i < n; i++)
+                    decoder.feed(buffer[i], t_now, emit);
+            }
+        }
+    }
+
+    int fd;
+    int wake[2]; // self-pipe to interrupt poll() on stop()
+    SpscQueue<key_event_t> queue;
+    std::atomic<bool> running;
+    std::atomic<bool> closed;
+    std::atomic<uint64_t> dropped_keys;
+    bool raw;
+    std::thread thread;
+};
+
 /**
  * @brief Check if a key is pressed.
  *
  * @brief It's an unblocking function that returns the number of bytes waiting in the input buffer.
+ * @brief The terminal is restored at exit. KeyboardInput avoids the system call per check.
  *
  * @return int The number of bytes waiting in the input buffer.
  */
-int kbhit()
+inline int kbhit()
 {
     static const int STDIN = 0;
     static bool initialized = false;
 
     if (!initialized)
     {
-        termios term;
-        tcgetattr(STDIN, &term);
-        term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
+        keyboard_terminal_raw(STDIN, true);
         setbuf(stdin, NULL);
         initialized = true;
     }
@@ -40,4 +596,4 @@ int kbhit()
     return bytesWaiting;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -3,17 +3,21 @@
  *
  * @brief This file contains a 1D Kalman filter with constant velocity model.
  *
- * This header was not used anymore, don't include it in the future.
+ * The state is (x, x_dot) and the measurement is x. Everything is written out
+ * in closed form on the 2x2 covariance, and the caller passes the measurement
+ * timestamp in seconds, so nothing here reads a clock or prints. Jitter
+ * (non-increasing timestamps) and resets (too long without a measurement)
+ * are counted in the filter instead.
+ *
+ * KF_bank runs the same filter on many channels (encoders, ultrasonics)
+ * stored as separate arrays, so KF_bank_update() is one branch-free loop the
+ * compiler can vectorize. KF_CA is the constant acceleration variant.
  */
 
 #ifndef KF_1d_V_CONST_H
 #define KF_1d_V_CONST_H
 
 #include <stdint.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <sys/time.h>
-#include <float.h>
 
 typedef struct
 {
@@ -21,103 +25,132 @@ typedef struct
     float x_dot;
 } differential_v_const_t;
 
-double get_time(void)
+typedef struct
 {
-    double tm;
-    struct timeval tim;
-
-    gettimeofday(&tim, NULL);
-
-    tm = (double)tim.tv_sec + tim.tv_usec / 1000000.0;
+    float x;
+    float x_dot;
+    float x_ddot;
+} differential_a_const_t;
 
-    return tm;
-}
+/**
+ * @brief Default time without a measurement after which a filter restarts, in seconds.
+ *
+ */
+#define KF_RESET_TIMEOUT_S 1.0f
 
 typedef struct
 {
-    differential_v_const_t uncertainly_est;
-    differential_v_const_t uncertainly_mea;
-
-    differential_v_const_t kalman_gain;
-
     differential_v_const_t current_state;
-    differential_v_const_t current_covariance;
 
-    differential_v_const_t prediction_state;
-    differential_v_const_t prediction_covariance;
+    // Covariance, p01 == p10
+    float p00;
+    float p01;
+    float p11;
+
+    float q;             // process noise, white acceleration spectral density
+    float r;             // measurement noise variance
+    float reset_timeout; // seconds without a measurement before restarting
 
-    double dt;
     double last_update_s;
 
     uint8_t has_init;
 
-    float q; // process noise
+    uint32_t jitter_count; // measurements with a non-increasing timestamp
+    uint32_t reset_count;  // restarts after reset_timeout
 
 } KF;
 
-void KF_init(KF *kf, float x, float x_dot)
+/**
+ * @brief Initialize the filter.
+ *
+ * @param kf The filter.
+ * @param q The process noise (white acceleration spectral density).
+ * @param r The measurement noise variance.
+ * @param x The initial position.
+ * @param x_dot The initial velocity.
+ * @param t The time of the initial state, in seconds.
+ */
+inline void KF_init(KF *kf, float q, float r, float x, float x_dot, double t)
 {
     kf->current_state.x = x;
     kf->current_state.x_dot = x_dot;
 
-    kf->current_covariance.x = kf->uncertainly_est.x;
-    kf->current_covariance.x_dot = kf->uncertainly_est.x_dot;
-
-    kf->prediction_state.x = kf->current_state.x + kf->current_state.x_dot * kf->dt;
-    kf->prediction_state.x_dot = kf->current_state.x_dot;
+    kf->p00 = r;
+    kf->p01 = 0;
+    kf->p11 = r;
 
-    kf->prediction_covariance.x = kf->current_covariance.x + kf->current_covariance.x_dot * kf->dt * kf->dt;
-    kf->prediction_covariance.x_dot = kf->current_covariance.x_dot;
-
-    kf->last_update_s = get_time() - kf->dt;
+    kf->q = q;
+    kf->r = r;
+    kf->reset_timeout = KF_RESET_TIMEOUT_S;
 
+    kf->last_update_s = t;
     kf->has_init = 1;
+    kf->jitter_count = 0;
+    kf->reset_count = 0;
 }
-differential_v_const_t KF_update(KF *kf, float x)
+
+/**
+ * @brief Update the filter with a measurement.
+ *
+ * @param kf The filter.
+ * @param x The measured position.
+ * @param t The measurement time, in seconds.
+ * @return differential_v_const_t The estimated state.
+ */
+inline differential_v_const_t KF_update(KF *kf, float x, double t)
 {
-    double t_now = get_time();
-    kf->dt = t_now - kf->last_update_s;
-    kf->last_update_s = t_now;
+    float dt = (float)(t - kf->last_update_s);
 
-    if (kf->dt < DBL_EPSILON)
+    if (dt <= 0)
     {
-        printf("TIME JITTER\n");
+        kf->jitter_count++;
         return kf->current_state;
     }
 
-    // Reset if there is new data coming
-    if (kf->dt > 1)
+    kf->last_update_s = t;
+
+    // Restart if there is new data after a long gap
+    if (dt > kf->reset_timeout)
     {
-        printf("RESET KF\n");
-        KF_init(kf, x, 0);
+        kf->reset_count++;
+        kf->current_state.x = x;
+        kf->current_state.x_dot = 0;
+        kf->p00 = kf->r;
+        kf->p01 = 0;
+        kf->p11 = kf->r;
         return kf->current_state;
     }
 
-    // Kalman gain calculation
-    kf->kalman_gain.x = kf->uncertainly_est.x / (kf->uncertainly_est.x + kf->uncertainly_mea.x);
-    kf->kalman_gain.x_dot = kf->uncertainly_est.x_dot / (kf->uncertainly_est.x_dot + kf->uncertainly_mea.x_dot);
+    // Prediction, P = F P F^T + Q
+    float dt2 = dt * dt;
+    kf->current_state.x += kf->current_state.x_dot * dt;
+    kf->p00 += dt * (2 * kf->p01 + dt * kf->p11) + kf->q * dt2 * dt / 3;
+    kf->p01 += dt * kf->p11 + kf->q * dt2 / 2;
+    kf->p11 += kf->q * dt;
 
-    // State calculation
-    kf->current_state.x = kf->prediction_state.x + kf->kalman_gain.x * (x - kf->prediction_state.x);
-    kf->current_state.x_dot = kf->prediction_state.x_dot + kf->kalman_gain.x_dot * (x - kf->prediction_state.x) / kf->dt;
+    // Correction
+    float k0 = kf->p00 / (kf->p00 + kf->r);
+    float k1 = kf->p01 / (kf->p00 + kf->r);
+    float innovation = x - kf->current_state.x;
 
-    kf->current_covariance.x = (1 - kf->kalman_gain.x) * kf->prediction_covariance.x;
-    kf->current_covariance.x_dot = (1 - kf->kalman_gain.x_dot) * kf->prediction_covariance.x_dot;
+    kf->current_state.x += k0 * innovation;
+    kf->current_state.x_dot += k1 * innovation;
 
-    // Prediction calculation
-    kf->prediction_state.x = kf->current_state.x + kf->current_state.x_dot * kf->dt;
-    kf->prediction_state.x_dot = kf->current_state.x_dot;
-
-    kf->prediction_covariance.x = kf->current_covariance.x + kf->current_covariance.x_dot * kf->dt * kf->dt;
-    kf->prediction_covariance.x_dot = kf->current_covariance.x_dot;
-
-    kf->uncertainly_est.x = kf->current_covariance.x + kf->q;
-    kf->uncertainly_est.x_dot = kf->current_covariance.x_dot + kf->q;
+    kf->p11 -= k1 * kf->p01;
+    kf->p01 -= k0 * kf->p01;
+    kf->p00 -= k0 * kf->p00;
 
     return kf->current_state;
 }
 
-differential_v_const_t KF_predict(KF *kf, float time_target)
+/**
+ * @brief Extrapolate the state without changing the filter.
+ *
+ * @param kf The filter.
+ * @param time_target The time ahead of the last measurement, in seconds.
+ * @return differential_v_const_t The predicted state.
+ */
+inline differential_v_const_t KF_predict(KF *kf, float time_target)
 {
     differential_v_const_t predicted_state;
 
@@ -127,4 +160,261 @@ differential_v_const_t KF_predict(KF *kf, float time_target)
     return predicted_state;
 }
 
-#endif
\ No newline at end of file
+/**
+ * @brief Many constant velocity filters sharing q, r and reset_timeout.
+ *
+ * The arrays are owned by the caller, one element per channel.
+ */
+typedef struct
+{
+    uint32_t n;
+
+    float *x;
+    float *x_dot;
+    float *p00;
+    float *p01;
+    float *p11;
+    double *last_update_s;
+
+    float q;
+    float r;
+    float reset_timeout;
+
+    uint32_t jitter_count;
+    uint32_t reset_count;
+
+} KF_bank;
+
+/**
+ * @brief Initialize a bank of filters on caller-owned storage.
+ *
+ * @param bank The bank.
+ * @param n The number of channels.
+ * @param storage 5 * n floats for the states and covariances.
+ * @param time_storage n doubles for the last update times.
+ * @param q The process noise (white acceleration spectral density).
+ * @param r The measurement noise variance.
+ * @param x0 The initial positions, may be NULL for zeros.
+ * @param t The time of the initial states, in seconds.
+ */
+inline void KF_bank_init(KF_bank *bank, uint32_t n, float *storage, double *time_storage, float q, float r, const float *x0, double t)
+{
+    bank->n = n;
+    bank->x = storage;
+    bank->x_dot = storage + n;
+    bank->p00 = storage + 2 * n;
+    bank->p01 = storage + 3 * n;
+    bank->p11 = storage + 4 * n;
+    bank->last_update_s = time_storage;
+
+    bank->q = q;
+    bank->r = r;
+    bank->reset_timeout = KF_RESET_TIMEOUT_S;
+    bank->jitter_count = 0;
+    bank->reset_count = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        bank->x[i] = x0 ? x0[i] : 0;
+        bank->x_dot[i] = 0;
+        bank->p00[i] = r;
+        bank->p01[i] = 0;
+        bank->p11[i] = r;
+        bank->last_update_s[i] = t;
+    }
+}
+
+/**
+ * @brief Update every channel of the bank in one pass.
+ *
+ * @param bank The bank.
+ * @param z The measured positions, one per channel.
+ * @param valid Optional, one byte per channel; channels with a zero byte are left untouched.
+ * @param t The measurement time shared by all channels, in seconds.
+ */
+inline void KF_bank_update(KF_bank *bank, const float *z, const uint8_t *valid, double t)
+{
+    float *__restrict x = bank->x;
+    float *__restrict x_dot = bank->x_dot;
+    float *__restrict p00 = bank->p00;
+    float *__restrict p01 = bank->p01;
+    float *__restrict p11 = bank->p11;
+    double *__restrict last = bank->last_update_s;
+    const float q = bank->q;
+    const float r = bank->r;
+    const float reset_timeout = bank->reset_timeout;
+    uint32_t jitter = 0;
+    uint32_t reset = 0;
+
+    for (uint32_t i = 0; i < bank->n; i++)
+    {
+        float dt = (float)(t - last[i]);
+        int use = valid ? valid[i] != 0 : 1;
+        int is_jitter = use & (dt <= 0);
+        int is_reset = use & (dt > reset_timeout);
+        int is_update = use & !is_jitter & !is_reset;
+        jitter += is_jitter;
+        reset += is_reset;
+
+        // Prediction
+        float dt2 = dt * dt;
+        float xp = x[i] + x_dot[i] * dt;
+        float a00 = p00[i] + dt * (2 * p01[i] + dt * p11[i]) + q * dt2 * dt / 3;
+        float a01 = p01[i] + dt * p11[i] + q * dt2 / 2;
+        float a11 = p11[i] + q * dt;
+
+        // Correction
+        float k0 = a00 / (a00 + r);
+        float k1 = a01 / (a00 + r);
+        float innovation = z[i] - xp;
+
+        float nx = xp + k0 * innovation;
+        float nv = x_dot[i] + k1 * innovation;
+        float n11 = a11 - k1 * a01;
+        float n01 = a01 - k0 * a01;
+        float n00 = a00 - k0 * a00;
+
+        x[i] = is_update ? nx : (is_reset ? z[i] : x[i]);
+        x_dot[i] = is_update ? nv : (is_reset ? 0.0f : x_dot[i]);
+        p00[i] = is_update ? n00 : (is_reset ? r : p00[i]);
+        p01[i] = is_update ? n01 : (is_reset ? 0.0f : p01[i]);
+        p11[i] = is_update ? n11 : (is_reset ? r : p11[i]);
+        last[i] = (is_update | is_reset) ? t : last[i];
+    }
+
+    bank->jitter_count += jitter;
+    bank->reset_count += reset;
+}
+
+/**
+ * @brief A 1D Kalman filter with constant acceleration model.
+ *
+ */
+typedef struct
+{
+    differential_a_const_t current_state;
+
+    // Upper triangle of the covariance
+    float p00, p01, p02;
+    float p11, p12;
+    float p22;
+
+    float q;             // process noise, white jerk spectral density
+    float r;             // measurement noise variance
+    float reset_timeout; // seconds without a measurement before restarting
+
+    double last_update_s;
+
+    uint8_t has_init;
+
+    uint32_t jitter_count;
+    uint32_t reset_count;
+
+} KF_CA;
+
+/**
+ * @brief Restart the constant acceleration filter at a position.
+ *
+ */
+inline void KF_CA_reset(KF_CA *kf, float x)
+{
+    kf->current_state.x = x;
+    kf->current_state.x_dot = 0;
+    kf->current_state.x_ddot = 0;
+    kf->p00 = kf->p11 = kf->p22 = kf->r;
+    kf->p01 = kf->p02 = kf->p12 = 0;
+}
+
+/**
+ * @brief Initialize the constant acceleration filter.
+ *
+ * @param kf The filter.
+ * @param q The process noise (white jerk spectral density).
+ * @param r The measurement noise variance.
+ * @param x The initial position.
+ * @param t The time of the initial state, in seconds.
+ */
+inline void KF_CA_init(KF_CA *kf, float q, float r, float x, double t)
+{
+    kf->q = q;
+    kf->r = r;
+    kf->reset_timeout = KF_RESET_TIMEOUT_S;
+    KF_CA_reset(kf, x);
+
+    kf->last_update_s = t;
+    kf->has_init = 1;
+    kf->jitter_count = 0;
+    kf->reset_count = 0;
+}
+
+/**
+ * @brief Update the constant acceleration filter with a measurement.
+ *
+ * @param kf The filter.
+ * @param x The measured position.
+ * @param t The measurement time, in seconds.
+ * @return differential_a_const_t The estimated state.
+ */
+inline differential_a_const_t KF_CA_update(KF_CA *kf, float x, double t)
+{
+    float dt = (float)(t - kf->last_update_s);
+
+    if (dt <= 0)
+    {
+        kf->jitter_count++;
+        return kf->current_state;
+    }
+
+    kf->last_update_s = t;
+
+    if (dt > kf->reset_timeout)
+    {
+        kf->reset_count++;
+        KF_CA_reset(kf, x);
+        return kf->current_state;
+    }
+
+    // Prediction, P = F P F^T + Q with F = [1 dt dt^2/2; 0 1 dt; 0 0 1]
+    float h = dt * dt / 2;
+    differential_a_const_t *s = &kf->current_state;
+    s->x += s->x_dot * dt + s->x_ddot * h;
+    s->x_dot += s->x_ddot * dt;
+
+    float a00 = kf->p00 + dt * kf->p01 + h * kf->p02;
+    float a01 = kf->p01 + dt * kf->p11 + h * kf->p12;
+    float a02 = kf->p02 + dt * kf->p12 + h * kf->p22;
+    float a11 = kf->p11 + dt * kf->p12;
+    float a12 = kf->p12 + dt * kf->p22;
+
+    float dt2 = dt * dt;
+    float dt3 = dt2 * dt;
+    kf->p00 = a00 + dt * a01 + h * a02 + kf->q * dt3 * dt2 / 20;
+    kf->p01 = a01 + dt * a02 + kf->q * dt2 * dt2 / 8;
+    kf->p02 = a02 + kf->q * dt3 / 6;
+    kf->p11 = a11 + dt * a12 + kf->q * dt3 / 3;
+    kf->p12 = a12 + kf->q * dt2 / 2;
+    kf->p22 += kf->q * dt;
+
+    // Correction
+    float s_inv = 1.0f / (kf->p00 + kf->r);
+    float k0 = kf->p00 * s_inv;
+    float k1 = kf->p01 * s_inv;
+    float k2 = kf->p02 * s_inv;
+    float innovation = x - s->x;
+
+    s->x += k0 * innovation;
+    s->x_dot += k1 * innovation;
+    s->x_ddot += k2 * innovation;
+
+    float r0 = kf->p00, r1 = kf->p01, r2 = kf->p02;
+    kf->p00 -= k0 * r0;
+    kf->p01 -= k0 * r1;
+    kf->p02 -= k0 * r2;
+    kf->p11 -= k1 * r1;
+    kf->p12 -= k1 * r2;
+    kf->p22 -= k2 * r2;
+
+    return kf->current_state;
+}
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * @file kf_history.h
+ *
+ * @brief This file contains the KalmanFilterHistory class.
+ *
+ * KalmanFilterHistory wraps a fixed-size KalmanFilter and keeps the last
+ * Capacity corrections as (t, x_hat, P, y) snapshots in a preallocated ring
+ * buffer. A measurement that arrives late is applied at its own timestamp:
+ * the filter is rolled back to the newest snapshot before it, corrected,
+ * and only the corrections after it are replayed.
+ */
+
+#ifndef KF_HISTORY_H
+#define KF_HISTORY_H
+
+#include "standard_kf.h"
+
+/**
+ * @brief A KalmanFilter with out-of-sequence measurement handling.
+ *
+ * For time-varying models set a transition function on the wrapped filter
+ * (KalmanFilter::setTransition), otherwise every replayed step uses the same A.
+ *
+ * @tparam N The state size.
+ * @tparam M The measurement size.
+ * @tparam Capacity The number of snapshots kept.
+ */
+template <int N, int M, int Capacity>
+class KalmanFilterHistory
+{
+    static_assert(N > 0 && M > 0, "KalmanFilterHistory needs fixed state and measurement sizes");
+    static_assert(Capacity > 1, "KalmanFilterHistory needs room for at least two snapshots");
+
+public:
+    typedef KalmanFilter<N, M> Filter;
+    typedef typename Filter::StateVector StateVector;
+    typedef typename Filter::StateMatrix StateMatrix;
+    typedef typename Filter::MeasurementVector MeasurementVector;
+    typedef KalmanSensor<N, M> Sensor;
+
+    /**
+     * @brief Construct a new KalmanFilterHistory object.
+     *
+     * @param filter The configured filter to wrap.
+     */
+    KalmanFilterHistory(const Filter &filter) : filter(filter), head(0), count(0), dropped_count(0)
+    {
+    }
+
+    /**
+     * @brief Initialize the filter with initial states as zero.
+     *
+     */
+    void init()
+    {
+        filter.init();
+        clear();
+    }
+
+    /**
+     * @brief Initialize the filter with a guess for initial states.
+     *
+     * @param t0 The initial time.
+     * @param x0 The initial state.
+     */
+    void init(double t0, const StateVector &x0)
+    {
+        filter.init(t0, x0);
+        clear();
+    }
+
+    /**
+     * @brief Propagate the estimate to time t.
+     *
+     * @param t The target time.
+     */
+    void predict(double t)
+    {
+        filter.predict(t);
+    }
+
+    /**
+     * @brief Correct the estimate with a measurement taken at time t.
+     *
+     * @param y The measurement.
+     * @param t The time the measurement was taken.
+     * @param sensor The sensor model, NULL for the one the filter was built with.
+     * The sensor must outlive the snapshots that reference it.
+     * @return bool False if the measurement is older than every snapshot and was dropped.
+     */
+    bool correct(const MeasurementVector &y, double t, const Sensor *sensor = NULL)
+    {
+        if (t >= filter.time())
+        {
+            apply(y, t, sensor);
+            insert(count, y, t, sensor);
+            return true;
+        }
+
+        // Newest snapshot taken at or before t
+        int k = count - 1;
+        while (k >= 0 && at(k).t > t)
+            k--;
+        if (k < 0)
+        {
+            dropped_count++;
+            return false;
+        }
+
+        double t_now = filter.time();
+        const Entry &base = at(k);
+        filter.restore(base.t, base.x, base.P);
+        apply(y, t, sensor);
+        int pos = insert(k + 1, y, t, sensor);
+
+        for (int i = pos + 1; i < count; i++)
+        {
+            Entry &e = at(i);
+            if (e.has_measurement)
+                apply(e.y, e.t, e.sensor);
+            else
+                filter.predict(e.t);
+            e.x = filter.state();
+            e.P = filter.covariance();
+        }
+        filter.predict(t_now);
+        return true;
+    }
+
+    /**
+     * @brief Return the current state and time.
+     *
+     */
+    StateVector state() { return filter.state(); }
+    double time() { return filter.time(); }
+
+    /**
+     * @brief Return the wrapped filter.
+     *
+     */
+    Filter &kalman() { return filter; }
+
+    /**
+     * @brief Return the number of snapshots held.
+     *
+     */
+    int size() const { return count; }
+
+    /**
+     * @brief Return how many measurements were too old to apply.
+     *
+     */
+    unsigned dropped() const { return dropped_count; }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    struct Entry
+    {
+        double t;
+        StateVector x;
+        StateMatrix P;
+        MeasurementVector y;
+        const Sensor *sensor;
+        bool has_measurement;
+    };
+
+    Entry &at(int i) { return entries[(head + i) % Capacity]; }
+
+    void apply(const MeasurementVector &y, double t, const Sensor *sensor)
+    {
+        if (sensor)
+            filter.correct(y, t, *sensor);
+        else
+            filter.correct(y, t);
+    }
+
+    /**
+     * Start over with the current estimate as the only snapshot.
+     */
+    void clear()
+    {
+        head = 0;
+        count = 1;
+        Entry &e = entries[0];
+        e.t = filter.time();
+        e.x = filter.state();
+        e.P = filter.covariance();
+        e.sensor = NULL;
+        e.has_measurement = false;
+    }
+
+    /**
+     * Store the filter estimate with its measurement at logical position pos,
+     * shifting newer snapshots up and dropping the oldest when full.
+     * Returns the position the snapshot ended up at.
+     */
+    int insert(int pos, const MeasurementVector &y, double t, const Sensor *sensor)
+    {
+        if (count == Capacity)
+        {
+            head = (head + 1) % Capacity;
+            count--;
+            pos--;
+        }
+        for (int i = count; i > pos; i--)
+            at(i) = at(i - 1);
+        count++;
+
+        Entry &e = at(pos);
+        e.t = t;
+        e.x = filter.state();
+        e.P = filter.covariance();
+        e.y = y;
+        e.sensor = sensor;
+        e.has_measurement = true;
+        return pos;
+    }
+
+    // The filter being tracked
+    Filter filter;
+
+    // Ring buffer of snapshots, oldest at head
+    Entry entries[Capacity];
+    int head, count;
+
+    // Measurements older than the oldest snapshot
+    unsigned dropped_count;
+};
+
+#endif // KF_HISTORY_H
@@ -0,0 +1,649 @@
+/**
+ * @file mot_tracker.h
+ *
+ * @brief This file contains the MotTracker class.
+ *
+ * A MotTracker follows many objects with one KalmanFilter each and matches
+ * every frame of detections to them:
+ * 1. Every track is predicted to the frame time.
+ * 2. Gating: a detection is a candidate for a track when its squared
+ *    Mahalanobis distance d^2 = v^T S^-1 v, with innovation v and
+ *    innovation covariance S = C P C^T + R, is below the gate. The
+ *    detections are put in a KdTree2D on their first two components, so
+ *    each track only looks at the few within sqrt(gate * trace(S)).
+ *    Prediction and gating run over chunks of tracks, on several threads if
+ *    asked. The worker threads are started with the tracker and wait for
+ *    work between frames, so update() does not create threads.
+ * 3. Assignment: the track-detection pairs form a sparse bipartite graph.
+ *    It is split into connected components and each component is solved
+ *    optimally with the Hungarian algorithm, a track either taking a
+ *    detection at cost d^2 or staying unmatched at cost gate. Confirmed
+ *    tracks are assigned first and tentative ones get the detections left
+ *    over, so a track started by one stray detection cannot take over an
+ *    established one. Components are small in practice, so the O(n^3)
+ *    solve is cheap.
+ * 4. Lifecycle: matched tracks are corrected; a track is TRACK_TENTATIVE
+ *    until it has confirm_hits hits, then TRACK_CONFIRMED, and
+ *    TRACK_DELETED after too many consecutive misses. Unmatched
+ *    detections start tentative tracks.
+ *
+ * Tracks live in a fixed pool allocated up front, so update() does not
+ * allocate once the scratch buffers have grown, and each track keeps a
+ * stable id that is never reused. A deleted track stays visible, with its
+ * state TRACK_DELETED, until the next update().
+ *
+ * @code{.cpp}
+ * MotTracker<4, 2> tracker(1000, A, C, Q, R, P0, cv_transition);
+ * ...
+ * tracker.update(t, detections.data(), detections.size());
+ * for (int slot : tracker.getActive())
+ * {
+ *     const MotTracker<4, 2>::Track &track = tracker.getTrack(slot);
+ *     if (track.state == TRACK_CONFIRMED)
+ *         draw(track.id, track.kf.state());
+ * }
+ * @endcode
+ */
+
+#ifndef MOT_TRACKER_H
+#define MOT_TRACKER_H
+
+#include "standard_kf.h"
+#include "spatial_index.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The lifecycle state of a track.
+ *
+ */
+enum MotTrackState
+{
+    TRACK_TENTATIVE,
+    TRACK_CONFIRMED,
+    TRACK_DELETED
+};
+
+/**
+ * @brief Tracker settings.
+ *
+ */
+typedef struct
+{
+    double gate;              // squared Mahalanobis distance gate, e.g. 9.21 (chi-square, 2 dof, 99%)
+    int confirm_hits;         // hits before a tentative track is confirmed
+    int max_misses_tentative; // consecutive misses before a tentative track is deleted
+    int max_misses_confirmed; // consecutive misses before a confirmed track is deleted
+    int threads;              // threads for prediction and gating, 0 or 1 for the calling thread only
+} mot_tracker_config_t;
+
+/**
+ * @brief Return the default tracker settings.
+ *
+ */
+inline mot_tracker_config_t mot_tracker_default_config()
+{
+    mot_tracker_config_t config;
+    config.gate = 9.21;
+    config.confirm_hits = 3;
+    config.max_misses_tentative = 1;
+    config.max_misses_confirmed = 5;
+    config.threads = 0;
+    return config;
+}
+
+/**
+ * @brief Solve a rectangular assignment problem with the Hungarian algorithm.
+ *
+ * @param cost The rows x cols cost matrix, row major, rows <= cols.
+ * @param rows The number of rows.
+ * @param cols The number of columns.
+ * @param row_to_col The column of each row, rows ints.
+ * @param u,v,p,way,minv,used Scratch, resized as needed.
+ */
+inline void hungarian_solve(const double *cost, int rows, int cols, int *row_to_col,
+                            std::vector<double> &u, std::vector<double> &v, std::vector<int> &p,
+                            std::vector<int> &way, std::vector<double> &minv, std::vector<char> &used)
+{
+    // Shortest augmenting paths with potentials, 1-based with column 0 as the root
+    u.assign(rows + 1, 0);
+    v.assign(cols + 1, 0);
+    p.assign(cols + 1, 0);
+    way.assign(cols + 1, 0);
+    for (int i = 1; i <= rows; i++)
+    {
+        p[0] = i;
+        int j0 = 0;
+        minv.assign(cols + 1, INFINITY);
+        used.assign(cols + 1, 0);
+        do
+        {
+            used[j0] = 1;
+            int i0 = p[j0], j1 = 0;
+            double delta = INFINITY;
+            for (int j = 1; j <= cols; j++)
+            {
+                if (used[j])
+                    continue;
+                double cur = cost[(size_t)(i0 - 1) * cols + (j - 1)] - u[i0] - v[j];
+                if (cur < minv[j])
+                {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta)
+                {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= cols; j++)
+            {
+                if (used[j])
+                {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                }
+                else
+                    minv[j] -= delta;
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do
+        {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+    for (int j = 1; j <= cols; j++)
+        if (p[j] != 0)
+            row_to_col[p[j] - 1] = j - 1;
+}
+
+/**
+ * @brief A multi-object tracker on Kalman filters.
+ *
+ * @tparam N The state size.
+ * @tparam M The measurement size; the first two components are used for the spatial gate.
+ */
+template <int N, int M>
+class MotTracker
+{
+    static_assert(N > 0 && M >= 2, "MotTracker needs a fixed state size and at least two measurement components");
+
+public:
+    typedef KalmanFilter<N, M> Filter;
+    typedef typename Filter::StateVector StateVector;
+    typedef typename Filter::MeasurementVector MeasurementVector;
+    typedef typename Filter::StateMatrix StateMatrix;
+    typedef typename Filter::OutputMatrix OutputMatrix;
+    typedef typename Filter::MeasurementMatrix MeasurementMatrix;
+
+    /**
+     * @brief One tracked object.
+     *
+     */
+    struct Track
+    {
+        uint32_t id;   // stable, never reused
+        int state;     // MotTrackState
+        int hits;      // matched frames
+        int misses;    // consecutive unmatched frames
+        int age;       // frames since the track started
+        int detection; // the detection matched in the last frame, -1 if none
+        Filter kf;
+
+        Track(const StateMatrix &A, const OutputMatrix &C, const StateMatrix &Q, const MeasurementMatrix &R, const StateMatrix &P0)
+            : id(0), state(TRACK_DELETED), hits(0), misses(0), age(0), detection(-1), kf(0, A, C, Q, R, P0) {}
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /**
+     * @brief Construct a new MotTracker object.
+     *
+     * @param capacity The maximum number of live tracks.
+     * @param A The system dynamics matrix.
+     * @param C The output matrix.
+     * @param Q The process noise covariance.
+     * @param R The measurement noise covariance.
+     * @param P0 The estimate error covariance of a new track.
+     * @param transition Rebuilds A and Q for a time step, see KalmanFilter::setTransition(); NULL to keep them.
+     * @param config The settings.
+     */
+    MotTracker(
+        size_t capacity,
+        const StateMatrix &A,
+        const OutputMatrix &C,
+        const StateMatrix &Q,
+        const MeasurementMatrix &R,
+        const StateMatrix &P0,
+        typename Filter::TransitionFunction transition,
+        const mot_tracker_config_t &config = mot_tracker_default_config())
+        : C(C), R(R), config(config), next_id(0), dropped(0),
+          work_generation(0), work_pending(0), work_quit(false), work_t(0), work_detections(NULL), work_chunks(0), next_chunk(0)
+    {
+        // A new track starts at the least-squares state of its detection
+        C_pinv = C.transpose() * (C * C.transpose()).inverse();
+
+        pool.reserve(capacity);
+        free_slots.reserve(capacity);
+        active.reserve(capacity);
+        for (size_t i = 0; i < capacity; i++)
+        {
+            pool.emplace_back(A, C, Q, R, P0);
+            pool[i].kf.setTransition(transition);
+            free_slots.push_back((int)(capacity - 1 - i));
+        }
+        startWorkers();
+    }
+
+    ~MotTracker() { stopWorkers(); }
+
+    MotTracker(const MotTracker &) = delete;
+    MotTracker &operator=(const MotTracker &) = delete;
+
+    /**
+     * @brief Process one frame of detections.
+     *
+     * @param t The frame time, seconds.
+     * @param detections The detections.
+     * @param count The number of detections.
+     */
+    void update(double t, const MeasurementVector *detections, int count)
+    {
+        releaseDeleted();
+
+        // Detections indexed by their first two components
+        det_x.resize(count);
+        det_y.resize(count);
+        for (int d = 0; d < count; d++)
+        {
+            det_x[d] = (float)detections[d](0);
+            det_y[d] = (float)detections[d](1);
+        }
+        tree.build(det_x.data(), det_y.data(), count);
+
+        gate(t, detections);
+
+        // Confirmed tracks first, then tentative ones on the detections left
+        track_det.assign(active.size(), -1);
+        det_taken.assign(count, 0);
+        assignStage(true);
+        assignStage(false);
+
+        // Lifecycle
+        det_track.assign(count, -1);
+        for (size_t a = 0; a < active.size(); a++)
+        {
+            Track &track = pool[active[a]];
+            track.age++;
+            track.detection = track_det[a];
+            if (track_det[a] >= 0)
+            {
+                track.kf.correct(detections[track_det[a]], t);
+                track.hits++;
+                track.misses = 0;
+                if (track.state == TRACK_TENTATIVE && track.hits >= config.confirm_hits)
+                    track.state = TRACK_CONFIRMED;
+                det_track[track_det[a]] = (int)track.id;
+            }
+            else
+            {
+                track.misses++;
+                int limit = track.state == TRACK_CONFIRMED ? config.max_misses_confirmed : config.max_misses_tentative;
+                if (track.misses > limit)
+                    track.state = TRACK_DELETED;
+            }
+        }
+
+        for (int d = 0; d < count; d++)
+        {
+            if (det_track[d] >= 0)
+                continue;
+            if (free_slots.empty())
+            {
+                dropped++;
+                continue;
+            }
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            Track &track = pool[slot];
+            track.id = next_id++;
+            track.state = config.confirm_hits <= 1 ? TRACK_CONFIRMED : TRACK_TENTATIVE;
+            track.hits = 1;
+            track.misses = 0;
+            track.age = 0;
+            track.detection = d;
+            track.kf.init(t, C_pinv * detections[d]);
+            active.push_back(slot);
+            det_track[d] = (int)track.id;
+        }
+    }
+
+    /**
+     * @brief Return the pool slots of the live tracks, and of the ones deleted by the last update().
+     *
+     */
+    const std::vector<int> &getActive() const { return active; }
+
+    /**
+     * @brief Return a track by pool slot.
+     *
+     */
+    const Track &getTrack(int slot) const { return pool[slot]; }
+
+    /**
+     * @brief Return, for each detection of the last frame, the id of the track it updated or started, -1 if dropped.
+     *
+     */
+    const std::vector<int> &getAssignment() const { return det_track; }
+
+    /**
+     * @brief Return the number of track-detection pairs that passed the gate in the last frame.
+     *
+     */
+    size_t getGatedPairs() const { return edges.size(); }
+
+    /**
+     * @brief Return the number of detections that could not start a track because the pool was full.
+     *
+     */
+    uint64_t getDropped() const { return dropped; }
+
+    /**
+     * @brief Set the number of threads for prediction and gating; restarts the worker threads.
+     *
+     */
+    void setThreads(int threads)
+    {
+        stopWorkers();
+        config.threads = threads;
+        startWorkers();
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    typedef struct
+    {
+        int track; // index into active
+        int det;
+        double cost; // d^2
+    } edge_t;
+
+    static const int CHUNK = 64;
+
+    OutputMatrix C;
+    MeasurementMatrix R;
+    Eigen::Matrix<double, N, M> C_pinv;
+    mot_tracker_config_t config;
+    uint32_t next_id;
+    uint64_t dropped;
+
+    std::vector<Track, Eigen::aligned_allocator<Track>> pool;
+    std::vector<int> free_slots;
+    std::vector<int> active;
+
+    // Per frame
+    std::vector<float> det_x, det_y;
+    KdTree2D tree;
+    std::vector<std::vector<edge_t>> chunk_edges;
+    std::vector<edge_t> edges, stage;
+    std::vector<uint8_t> det_taken;
+    std::vector<int> track_det, det_track;
+    std::vector<int> near;
+
+    // Assignment scratch
+    std::vector<int> parent, comp_start, comp_edges, local_track, local_det, rows, row_to_col;
+    std::vector<double> cost, hu, hv, hminv;
+    std::vector<int> hp, hway;
+    std::vector<char> hused;
+
+    // Gating workers, woken once per frame; the calling thread takes chunks too
+    std::vector<std::thread> workers;
+    std::vector<std::vector<int>> worker_near;
+    std::mutex work_mutex;
+    std::condition_variable work_cv, done_cv;
+    uint64_t work_generation;
+    size_t work_pending;
+    bool work_quit;
+    double work_t;
+    const MeasurementVector *work_detections;
+    size_t work_chunks;
+    std::atomic<size_t> next_chunk;
+
+    void releaseDeleted()
+    {
+        size_t kept = 0;
+        for (size_t a = 0; a < active.size(); a++)
+        {
+            if (pool[active[a]].state == TRACK_DELETED)
+                free_slots.push_back(active[a]);
+            else
+                active[kept++] = active[a];
+        }
+        active.resize(kept);
+    }
+
+    // Predict and gate the tracks of one chunk
+    void gateChunk(size_t chunk, double t, const MeasurementVector *detections, std::vector<int> &near)
+    {
+        std::vector<edge_t> &out = chunk_edges[chunk];
+        out.clear();
+        size_t end = std::min(active.size(), (chunk + 1) * CHUNK);
+        for (size_t a = chunk * CHUNK; a < end; a++)
+        {
+            Filter &kf = pool[active[a]].kf;
+            kf.predict(t);
+
+            MeasurementVector z = C * kf.state();
+            MeasurementMatrix S = C * kf.covariance() * C.transpose() + R;
+            MeasurementMatrix S_inv = S.inverse();
+
+            // d^2 <= gate implies |v|^2 <= gate * trace(S), and the first two components are part of |v|
+            near.clear();
+            tree.radius((float)z(0), (float)z(1), (float)std::sqrt(config.gate * S.trace()), near);
+            for (size_t k = 0; k < near.size(); k++)
+            {
+                MeasurementVector v = detections[near[k]] - z;
+                double d2 = v.dot(S_inv * v);
+                if (d2 < config.gate)
+                    out.push_back(edge_t{(int)a, near[k], d2});
+            }
+        }
+    }
+
+    void startWorkers()
+    {
+        int extra = std::max(0, config.threads - 1);
+        worker_near.resize(extra);
+        for (int i = 0; i < extra; i++)
+            workers.emplace_back(&MotTracker::workerLoop, this, i, work_generation);
+    }
+
+    void stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(work_mutex);
+            work_quit = true;
+        }
+        work_cv.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+        workers.clear();
+        work_quit = false;
+    }
+
+    void workerLoop(int index, uint64_t seen)
+    {
+        std::unique_lock<std::mutex> lock(work_mutex);
+        while (true)
+        {
+            work_cv.wait(lock, [&]()
+                         { return work_quit || work_generation != seen; });
+            if (work_quit)
+                return;
+            seen = work_generation;
+            lock.unlock();
+            gateChunks(worker_near[index]);
+            lock.lock();
+            if (--work_pending == 0)
+                done_cv.notify_one();
+        }
+    }
+
+    void gateChunks(std::vector<int> &near)
+    {
+        for (size_t c = next_chunk.fetch_add(1); c < work_chunks; c = next_chunk.fetch_add(1))
+            gateChunk(c, work_t, work_detections, near);
+    }
+
+    void gate(double t, const MeasurementVector *detections)
+    {
+        size_t chunks = (active.size() + CHUNK - 1) / CHUNK;
+        chunk_edges.resize(chunks);
+
+        if (workers.empty() || chunks <= 1)
+        {
+            for (size_t c = 0; c < chunks; c++)
+                gateChunk(c, t, detections, near);
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(work_mutex);
+                work_t = t;
+                work_detections = detections;
+                work_chunks = chunks;
+                next_chunk.store(0);
+                work_pending = workers.size();
+                work_generation++;
+            }
+            work_cv.notify_all();
+            gateChunks(near);
+            std::unique_lock<std::mutex> lock(work_mutex);
+            done_cv.wait(lock, [&]()
+                         { return work_pending == 0; });
+        }
+
+        // Concatenated in chunk order, so the result does not depend on the threads
+        edges.clear();
+        for (size_t c = 0; c < chunks; c++)
+            edges.insert(edges.end(), chunk_edges[c].begin(), chunk_edges[c].end());
+    }
+
+    int findRoot(int a)
+    {
+        while (parent[a] != a)
+        {
+            parent[a] = parent[parent[a]];
+            a = parent[a];
+        }
+        return a;
+    }
+
+    void assignStage(bool confirmed)
+    {
+        stage.clear();
+        for (size_t e = 0; e < edges.size(); e++)
+            if ((pool[active[edges[e].track]].state == TRACK_CONFIRMED) == confirmed && !det_taken[edges[e].det])
+                stage.push_back(edges[e]);
+
+        int tracks = (int)active.size();
+        int nodes = tracks + (int)det_x.size();
+
+        // Connected components of the gated graph; tracks are nodes 0..tracks-1, detections follow
+        parent.resize(nodes);
+        for (int i = 0; i < nodes; i++)
+            parent[i] = i;
+        for (size_t e = 0; e < stage.size(); e++)
+        {
+            int a = findRoot(stage[e].track), b = findRoot(tracks + stage[e].det);
+            if (a != b)
+                parent[std::max(a, b)] = std::min(a, b);
+        }
+
+        // Edges grouped by component root, in a counting sort
+        comp_start.assign(nodes + 1, 0);
+        for (size_t e = 0; e < stage.size(); e++)
+            comp_start[findRoot(stage[e].track) + 1]++;
+        for (int i = 0; i < nodes; i++)
+            comp_start[i + 1] += comp_start[i];
+        comp_edges.resize(stage.size());
+        local_track.assign(comp_start.begin(), comp_start.end() - 1);
+        for (size_t e = 0; e < stage.size(); e++)
+            comp_edges[local_track[findRoot(stage[e].track)]++] = (int)e;
+
+        // Local indices of tracks and detections inside their component
+        local_track.assign(tracks, -1);
+        local_det.assign(det_x.size(), -1);
+        for (int root = 0; root < tracks; root++)
+        {
+            int first = comp_start[root], last = comp_start[root + 1];
+            if (first == last)
+                continue;
+            if (last - first == 1)
+            {
+                const edge_t &e = stage[comp_edges[first]];
+                track_det[e.track] = e.det;
+                det_taken[e.det] = 1;
+                continue;
+            }
+
+            rows.clear();
+            int cols = 0;
+            for (int k = first; k < last; k++)
+            {
+                const edge_t &e = stage[comp_edges[k]];
+                if (local_track[e.track] < 0)
+                {
+                    local_track[e.track] = (int)rows.size();
+                    rows.push_back(e.track);
+                }
+                if (local_det[e.det] < 0)
+                    local_det[e.det] = cols++;
+            }
+
+            // Each track takes a detection or its own "unmatched" column
+            int nr = (int)rows.size(), nc = cols + nr;
+            const double forbidden = 1e12;
+            cost.assign((size_t)nr * nc, forbidden);
+            for (int r = 0; r < nr; r++)
+                cost[(size_t)r * nc + cols + r] = config.gate;
+            for (int k = first; k < last; k++)
+            {
+                const edge_t &e = stage[comp_edges[k]];
+                cost[(size_t)local_track[e.track] * nc + local_det[e.det]] = e.cost;
+            }
+
+            row_to_col.resize(nr);
+            hungarian_solve(cost.data(), nr, nc, row_to_col.data(), hu, hv, hp, hway, hminv, hused);
+
+            for (int k = first; k < last; k++)
+            {
+                const edge_t &e = stage[comp_edges[k]];
+                if (row_to_col[local_track[e.track]] == local_det[e.det])
+                {
+                    track_det[e.track] = e.det;
+                    det_taken[e.det] = 1;
+                }
+            }
+            for (int k = first; k < last; k++)
+            {
+                const edge_t &e = stage[comp_edges[k]];
+                local_track[e.track] = -1;
+                local_det[e.det] = -1;
+            }
+        }
+    }
+};
+
+#endif // MOT_TRACKER_H
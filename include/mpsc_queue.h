@@ -0,0 +1,117 @@
+/**
+ * @file mpsc_queue.h
+ *
+ * @brief This file contains the MpscQueue class.
+ *
+ * A bounded lock-free queue for many producers and one consumer, after
+ * Dmitry Vyukov's bounded MPMC queue. Every cell carries a sequence number:
+ * producers claim a cell with one compare-and-swap on the enqueue position,
+ * the consumer only does plain loads and stores, and nothing allocates after
+ * construction.
+ */
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief A bounded multi-producer single-consumer queue.
+ *
+ * @tparam T The element type, copied in and out.
+ */
+template <class T>
+class MpscQueue
+{
+public:
+    /**
+     * @brief Construct a new MpscQueue object.
+     *
+     * @param capacity The number of elements, rounded up to a power of two.
+     */
+    MpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        dequeue_pos = 0;
+    }
+
+    /**
+     * @brief Add an element, callable from any thread.
+     *
+     * @param value The element.
+     * @return bool False if the queue is full.
+     */
+    bool push(const T &value)
+    {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest element, only from the consumer thread.
+     *
+     * @param value The element, written on success.
+     * @return bool False if the queue is empty.
+     */
+    bool pop(T &value)
+    {
+        Cell *cell = &cells[dequeue_pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(dequeue_pos + 1) < 0)
+            return false;
+        value = cell->value;
+        cell->sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+        dequeue_pos++;
+        return true;
+    }
+
+    /**
+     * @brief Return the capacity.
+     *
+     */
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    // Producers and the consumer on separate cache lines
+    alignas(64) std::atomic<size_t> enqueue_pos;
+    alignas(64) size_t dequeue_pos;
+};
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,488 @@
+/**
+ * @file odometry.h
+ *
+ * @brief This file contains wheel odometry on top of enc_t.
+ *
+ * Odometry<Kinematics> turns raw 16-bit encoder counts of N wheels into a
+ * pose2d_t. The drive model is a template parameter:
+ * - DiffDriveKinematics: 2 wheels, left and right;
+ * - MecanumKinematics: 4 wheels, front-left, front-right, rear-left, rear-right;
+ * - OmniKinematics<3>, OmniKinematics<4>: omni wheels on a circle.
+ *
+ * Every model is a constant 3 x N matrix from wheel travel to body motion
+ * (dx, dy, dtheta in the robot frame). The per-wheel metres-per-tick are
+ * folded into it once, so one encoder sample costs N integer subtractions,
+ * a 3 x N multiply and one arc step, all inlined into the batch loop.
+ *
+ * Counters may wrap: the delta of a wheel is taken modulo 2^16, which is
+ * right as long as a wheel moves less than 32768 ticks between two samples.
+ *
+ * Each sample is integrated as a constant-twist arc (exact SE(2)
+ * exponential), not a straight Euler step, so the result does not depend on
+ * how a motion is split into samples. The sin/cos of the per-sample heading
+ * change are series expansions when it is small, which it always is at high
+ * encoder rates; the heading is carried as a unit vector and resynchronised
+ * from the accumulated angle once per batch. The state is kept in double.
+ *
+ * @code{.cpp}
+ * Odometry<DiffDriveKinematics> odom(DiffDriveKinematics(0.32), 2 * M_PI * 0.05 / 4096);
+ * odom.reset(first_counts);
+ * ...
+ * odom.update(burst, n); // n samples of {left, right}, e.g. 10 per ms at 10 kHz
+ * pose2d_t pose = odom.getPose();
+ * @endcode
+ */
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include "custom_typedef.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ODOMETRY_PI 3.14159265358979323846
+// below this heading change per step the sin/cos series are used
+#define ODOMETRY_SERIES_LIMIT 0.05
+
+/**
+ * @brief Return the signed tick difference curr - prev of a 16-bit counter, across wraparound.
+ *
+ */
+inline int16_t enc_delta(uint16_t curr, uint16_t prev)
+{
+    return (int16_t)(uint16_t)(curr - prev);
+}
+
+/**
+ * @brief Push a new counter reading into an enc_t.
+ *
+ * prev_px takes the old curr_px, curr_px takes px and speed becomes the
+ * wrapped tick difference between them (ticks per sample).
+ */
+inline void enc_update(enc_t *enc, uint16_t px)
+{
+    enc->prev_px = enc->curr_px;
+    enc->curr_px = px;
+    enc->speed = enc_delta(enc->curr_px, enc->prev_px);
+}
+
+/**
+ * @brief Advance a pose by a body-frame motion along a constant-twist arc.
+ *
+ * @param dx The forward travel in the robot frame at the start of the motion.
+ * @param dy The leftward travel in the robot frame at the start of the motion.
+ * @param dtheta The heading change, counter-clockwise.
+ */
+inline void pose_integrate_arc(pose2d_t *pose, float dx, float dy, float dtheta)
+{
+    double t = dtheta;
+    double a, b; // sin(t) / t, (1 - cos(t)) / t
+    if (fabs(t) < ODOMETRY_SERIES_LIMIT)
+    {
+        double t2 = t * t;
+        a = 1.0 - t2 * (1.0 / 6.0 - t2 * (1.0 / 120.0 - t2 * (1.0 / 5040.0)));
+        b = t * (0.5 - t2 * (1.0 / 24.0 - t2 * (1.0 / 720.0 - t2 * (1.0 / 40320.0))));
+    }
+    else
+    {
+        a = sin(t) / t;
+        b = (1.0 - cos(t)) / t;
+    }
+    double lx = a * dx - b * dy;
+    double ly = b * dx + a * dy;
+    double c = cos((double)pose->theta);
+    double s = sin((double)pose->theta);
+    pose->x = (float)(pose->x + c * lx - s * ly);
+    pose->y = (float)(pose->y + s * lx + c * ly);
+    pose->theta = (float)remainder(pose->theta + t, 2.0 * ODOMETRY_PI);
+}
+
+/**
+ * @brief The common part of the drive models: a 3 x N matrix from wheel travel to body motion.
+ *
+ * Row 0 is dx, row 1 dy, row 2 dtheta; column i is wheel i, in metres of
+ * wheel surface travel.
+ */
+template <int N>
+struct WheelKinematics
+{
+    static_assert(N > 0, "WheelKinematics needs at least one wheel");
+    static constexpr int WHEELS = N;
+
+    double J[3][N];
+};
+
+/**
+ * @brief Differential drive: wheel 0 left, wheel 1 right, both positive forward.
+ *
+ */
+struct DiffDriveKinematics : WheelKinematics<2>
+{
+    /**
+     * @brief Construct a new DiffDriveKinematics object.
+     *
+     * @param track_width The distance between the two wheel contact points.
+     */
+    DiffDriveKinematics(double track_width)
+    {
+        J[0][0] = 0.5;
+        J[0][1] = 0.5;
+        J[1][0] = 0.0;
+        J[1][1] = 0.0;
+        J[2][0] = -1.0 / track_width;
+        J[2][1] = 1.0 / track_width;
+    }
+};
+
+/**
+ * @brief Mecanum drive with rollers in the X pattern seen from above.
+ *
+ * Wheels 0..3 are front-left, front-right, rear-left, rear-right, all
+ * positive when rolling the robot forward.
+ */
+struct MecanumKinematics : WheelKinematics<4>
+{
+    /**
+     * @brief Construct a new MecanumKinematics object.
+     *
+     * @param half_wheelbase The distance from the centre to the front axle.
+     * @param half_track The distance from the centre to the left wheels.
+     */
+    MecanumKinematics(double half_wheelbase, double half_track)
+    {
+        static const double sign[3][4] = {
+            {1.0, 1.0, 1.0, 1.0},
+            {-1.0, 1.0, 1.0, -1.0},
+            {-1.0, 1.0, -1.0, 1.0},
+        };
+        double k = 1.0 / (half_wheelbase + half_track);
+        for (int i = 0; i < 4; i++)
+        {
+            J[0][i] = 0.25 * sign[0][i];
+            J[1][i] = 0.25 * sign[1][i];
+            J[2][i] = 0.25 * k * sign[2][i];
+        }
+    }
+};
+
+/**
+ * @brief Omni wheels on a circle around the centre.
+ *
+ * Wheel i sits at angle angles[i] from the robot x axis and is positive when
+ * it pushes the robot counter-clockwise around the centre. The matrix is the
+ * least-squares inverse of the wheel model, so with 4 wheels any slip
+ * inconsistency between them is averaged out.
+ */
+template <int N>
+struct OmniKinematics : WheelKinematics<N>
+{
+    static_assert(N == 3 || N == 4, "OmniKinematics supports 3 or 4 wheels");
+
+    /**
+     * @brief Construct a new OmniKinematics object with evenly spaced wheels.
+     *
+     * @param radius The distance from the centre to the wheel contact points.
+     * @param first_angle The angle of wheel 0; the others follow counter-clockwise.
+     */
+    OmniKinematics(double radius, double first_angle)
+    {
+        double angles[N];
+        for (int i = 0; i < N; i++)
+            angles[i] = first_angle + 2.0 * ODOMETRY_PI * i / N;
+        build(radius, angles);
+    }
+
+    /**
+     * @brief Construct a new OmniKinematics object with the given wheel angles.
+     *
+     * @param radius The distance from the centre to the wheel contact points.
+     * @param angles The N wheel angles in radians.
+     */
+    OmniKinematics(double radius, const double *angles)
+    {
+        build(radius, angles);
+    }
+
+private:
+    void build(double radius, const double *angles)
+    {
+        // wheel model: travel_i = H[i] . (dx, dy, dtheta)
+        double H[N][3];
+        for (int i = 0; i < N; i++)
+        {
+            H[i][0] = -sin(angles[i]);
+            H[i][1] = cos(angles[i]);
+            H[i][2] = radius;
+        }
+
+        double A[3][3] = {};
+        for (int i = 0; i < N; i++)
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++)
+                    A[r][c] += H[i][r] * H[i][c];
+
+        double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) -
+                     A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) +
+                     A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+        double inv[3][3];
+        inv[0][0] = (A[1][1] * A[2][2] - A[1][2] * A[2][1]) / det;
+        inv[0][1] = (A[0][2] * A[2][1] - A[0][1] * A[2][2]) / det;
+        inv[0][2] = (A[0][1] * A[1][2] - A[0][2] * A[1][1]) / det;
+        inv[1][0] = (A[1][2] * A[2][0] - A[1][0] * A[2][2]) / det;
+        inv[1][1] = (A[0][0] * A[2][2] - A[0][2] * A[2][0]) / det;
+        inv[1][2] = (A[0][2] * A[1][0] - A[0][0] * A[1][2]) / det;
+        inv[2][0] = (A[1][0] * A[2][1] - A[1][1] * A[2][0]) / det;
+        inv[2][1] = (A[0][1] * A[2][0] - A[0][0] * A[2][1]) / det;
+        inv[2][2] = (A[0][0] * A[1][1] - A[0][1] * A[1][0]) / det;
+
+        for (int r = 0; r < 3; r++)
+            for (int i = 0; i < N; i++)
+                this->J[r][i] = inv[r][0] * H[i][0] + inv[r][1] * H[i][1] + inv[r][2] * H[i][2];
+    }
+};
+
+/**
+ * @brief Wheel odometry for the drive model Kinematics.
+ *
+ */
+template <class Kinematics>
+class Odometry
+{
+public:
+    static constexpr int WHEELS = Kinematics::WHEELS;
+
+    /**
+     * @brief Construct a new Odometry object with the same scale on every wheel.
+     *
+     * @param kinematics The drive model.
+     * @param meters_per_tick The wheel travel per encoder tick, 2 pi r / ticks per revolution.
+     */
+    Odometry(const Kinematics &kinematics, double meters_per_tick)
+    {
+        double scale[WHEELS];
+        for (int i = 0; i < WHEELS; i++)
+            scale[i] = meters_per_tick;
+        setScale(kinematics, scale);
+        setPose({0.0f, 0.0f, 0.0f});
+    }
+
+    /**
+     * @brief Construct a new Odometry object with a scale per wheel.
+     *
+     * @param kinematics The drive model.
+     * @param meters_per_tick WHEELS values; a negative one flips a wheel whose encoder counts backwards.
+     */
+    Odometry(const Kinematics &kinematics, const double *meters_per_tick)
+    {
+        setScale(kinematics, meters_per_tick);
+        setPose({0.0f, 0.0f, 0.0f});
+    }
+
+    /**
+     * @brief Take the current counter readings as the starting point of the raw-count update().
+     *
+     * @param px WHEELS counter readings.
+     */
+    void reset(const uint16_t *px)
+    {
+        for (int i = 0; i < WHEELS; i++)
+            last_px[i] = px[i];
+        has_px = true;
+    }
+
+    /**
+     * @brief Integrate a burst of raw counter readings.
+     *
+     * Without a prior reset() the first sample only sets the starting point.
+     *
+     * @param px count samples of WHEELS readings each, sample-major (px[k * WHEELS + wheel]).
+     * @param count The number of samples.
+     */
+    void update(const uint16_t *px, size_t count)
+    {
+        if (count == 0)
+            return;
+        if (!has_px)
+        {
+            reset(px);
+            px += WHEELS;
+            count--;
+        }
+
+        begin();
+        for (size_t k = 0; k < count; k++, px += WHEELS)
+        {
+            int32_t d[WHEELS];
+            for (int i = 0; i < WHEELS; i++)
+            {
+                d[i] = enc_delta(px[i], last_px[i]);
+                last_px[i] = px[i];
+            }
+            step(d);
+        }
+        end();
+    }
+
+    /**
+     * @brief Integrate a burst of tick differences, e.g. from counters that reset on every read.
+     *
+     * @param ticks count samples of WHEELS differences each, sample-major.
+     * @param count The number of samples.
+     */
+    void updateDeltas(const int16_t *ticks, size_t count)
+    {
+        begin();
+        for (size_t k = 0; k < count; k++, ticks += WHEELS)
+        {
+            int32_t d[WHEELS];
+            for (int i = 0; i < WHEELS; i++)
+                d[i] = ticks[i];
+            step(d);
+        }
+        end();
+    }
+
+    /**
+     * @brief Integrate one sample from WHEELS enc_t kept up to date with enc_update().
+     *
+     * Uses the wrapped curr_px - prev_px of each wheel; independent of the
+     * readings remembered by the raw-count update().
+     */
+    void update(const enc_t *enc)
+    {
+        int32_t d[WHEELS];
+        for (int i = 0; i < WHEELS; i++)
+            d[i] = enc_delta(enc[i].curr_px, enc[i].prev_px);
+        begin();
+        step(d);
+        end();
+    }
+
+    /**
+     * @brief Set the pose, e.g. after a relocalisation.
+     *
+     */
+    void setPose(pose2d_t pose)
+    {
+        x = pose.x;
+        y = pose.y;
+        theta = remainder((double)pose.theta, 2.0 * ODOMETRY_PI);
+        c = cos(theta);
+        s = sin(theta);
+        delta = {0.0f, 0.0f, 0.0f};
+    }
+
+    /**
+     * @brief Get the pose, theta in [-pi, pi].
+     *
+     */
+    pose2d_t getPose() const
+    {
+        return {(float)x, (float)y, (float)theta};
+    }
+
+    /**
+     * @brief Get the motion of the last update in the robot frame at its start.
+     *
+     * This is the odometry increment for a filter prediction step.
+     */
+    pose2d_t getDelta() const
+    {
+        return delta;
+    }
+
+    /**
+     * @brief Get the travelled distance of the centre along its path.
+     *
+     */
+    double getDistance() const
+    {
+        return distance;
+    }
+
+private:
+    void setScale(const Kinematics &kinematics, const double *meters_per_tick)
+    {
+        for (int r = 0; r < 3; r++)
+            for (int i = 0; i < WHEELS; i++)
+                J[r][i] = kinematics.J[r][i] * meters_per_tick[i];
+        for (int i = 0; i < WHEELS; i++)
+            last_px[i] = 0;
+        has_px = false;
+        distance = 0.0;
+    }
+
+    void begin()
+    {
+        x0 = x;
+        y0 = y;
+        theta0 = theta;
+        c0 = c;
+        s0 = s;
+    }
+
+    void step(const int32_t *d)
+    {
+        double dx = 0.0, dy = 0.0, t = 0.0;
+        for (int i = 0; i < WHEELS; i++)
+        {
+            dx += J[0][i] * d[i];
+            dy += J[1][i] * d[i];
+            t += J[2][i] * d[i];
+        }
+
+        double a, b, sn, cs; // sin(t) / t, (1 - cos(t)) / t, sin(t), cos(t)
+        if (fabs(t) < ODOMETRY_SERIES_LIMIT)
+        {
+            double t2 = t * t;
+            a = 1.0 - t2 * (1.0 / 6.0 - t2 * (1.0 / 120.0 - t2 * (1.0 / 5040.0)));
+            b = t * (0.5 - t2 * (1.0 / 24.0 - t2 * (1.0 / 720.0 - t2 * (1.0 / 40320.0))));
+            sn = t * a;
+            cs = 1.0 - t * b;
+        }
+        else
+        {
+            sn = sin(t);
+            cs = cos(t);
+            a = sn / t;
+            b = (1.0 - cs) / t;
+        }
+
+        double lx = a * dx - b * dy;
+        double ly = b * dx + a * dy;
+        x += c * lx - s * ly;
+        y += s * lx + c * ly;
+        theta += t;
+        double nc = c * cs - s * sn;
+        s = s * cs + c * sn;
+        c = nc;
+        // the constant-twist path has length |(dx, dy)|, not the chord
+        distance += sqrt(dx * dx + dy * dy);
+    }
+
+    void end()
+    {
+        theta = remainder(theta, 2.0 * ODOMETRY_PI);
+        c = cos(theta);
+        s = sin(theta);
+
+        double ex = x - x0, ey = y - y0;
+        delta.x = (float)(c0 * ex + s0 * ey);
+        delta.y = (float)(-s0 * ex + c0 * ey);
+        delta.theta = (float)remainder(theta - theta0, 2.0 * ODOMETRY_PI);
+    }
+
+    double J[3][WHEELS];
+    uint16_t last_px[WHEELS];
+    bool has_px;
+
+    double x, y, theta;
+    double c, s; // cos(theta), sin(theta)
+    double x0, y0, theta0, c0, s0;
+    double distance;
+    pose2d_t delta;
+};
+
+#endif // ODOMETRY_H
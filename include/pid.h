@@ -9,13 +9,17 @@
 #ifndef PID_H_
 #define PID_H_
 
+#include "custom_time.h"
+
 #include <chrono>
 
 /**
  * @brief The PID class.
  *
+ * @tparam Clock The clock used to detect idle periods, see custom_time.h.
  */
-class PID
+template <class Clock = MonotonicClock>
+class BasicPID
 {
     float Kp;
     float Ki;
@@ -29,8 +33,9 @@ class PID
     float proportional;
     float derivative;
     float output_speed;
-    std::chrono::system_clock::time_point last_call;
+    typename Clock::time_point last_call;
 
+public:
     /**
      * @brief Construct a new PID object.
      *
@@ -38,11 +43,19 @@ class PID
      * @param Ki The integral gain.
      * @param Kd The derivative gain.
      */
-    PID(float Kp, float Ki, float Kd)
+    BasicPID(float Kp, float Ki, float Kd)
     {
         this->Kp = Kp;
         this->Ki = Ki;
         this->Kd = Kd;
+        this->min_out = this->min_integral = 0;
+        this->max_out = this->max_integral = 0;
+        this->integral = 0;
+        this->last_error = 0;
+        this->proportional = 0;
+        this->derivative = 0;
+        this->output_speed = 0;
+        this->last_call = Clock::now();
     }
 
     /**
@@ -54,14 +67,14 @@ class PID
      */
     float calculate(float error, float minmax)
     {
-        std::chrono::high_resolution_clock::time_point t_now = std::chrono::high_resolution_clock::now();
+        typename Clock::time_point t_now = Clock::now();
         std::chrono::duration<double> elapsed_seconds = t_now - this->last_call;
         if (elapsed_seconds.count() > 2)
         {
             this->integral = 0;
             this->last_error = 0;
         }
-        this->last_call = std::chrono::high_resolution_clock::now();
+        this->last_call = t_now;
 
         this->min_out = this->min_integral = -minmax;
         this->max_out = this->max_integral = minmax;
@@ -70,7 +83,6 @@ class PID
         this->integral += this->Ki * error;
         this->derivative = this->Kd * (error - this->last_error);
 
-        // printf("%.2f %.2f %.2f %.2f %.2f\n", this->proportional, this->integral, this->derivative, error, this->last_error);
         this->last_error = error;
 
         if (this->integral > this->max_integral)
@@ -86,6 +98,21 @@ class PID
             this->output_speed = this->min_out;
         return this->output_speed;
     }
+
+    /**
+     * @brief Return the terms of the last calculate(), e.g. for telemetry.h.
+     *
+     */
+    float getProportional() const { return proportional; }
+    float getIntegral() const { return integral; }
+    float getDerivative() const { return derivative; }
+    float getOutput() const { return output_speed; }
 };
 
+/**
+ * @brief The PID class on the monotonic clock.
+ *
+ */
+typedef BasicPID<> PID;
+
 #endif // PID_H_
\ No newline at end of file
@@ -0,0 +1,152 @@
+/**
+ * @file pid_bank.h
+ *
+ * @brief This file contains the PIDBank class.
+ *
+ * PIDBank computes the same control law as PID::calculate for many channels
+ * (e.g. every joint of a robot) at once. The gains, limits and state of all
+ * channels are kept as contiguous arrays and calculate() is one branch-free
+ * loop over them, which the compiler vectorizes. The caller supplies one
+ * timestamp for the whole cycle instead of every channel reading the clock.
+ */
+
+#ifndef PID_BANK_H
+#define PID_BANK_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief A bank of PID controllers evaluated together.
+ *
+ */
+class PIDBank
+{
+public:
+    /**
+     * @brief Construct a new PIDBank object with zero gains and limits.
+     *
+     * @param n The number of channels.
+     */
+    PIDBank(int n)
+        : Kp(n, 0.0f), Ki(n, 0.0f), Kd(n, 0.0f), limit(n, 0.0f),
+          integral(n, 0.0f), last_error(n, 0.0f), proportional(n, 0.0f), derivative(n, 0.0f),
+          reset_timeout_ns(2000000000ULL), last_call_ns(0), has_run(false)
+    {
+    }
+
+    /**
+     * @brief Set the gains of one channel.
+     *
+     * @param i The channel.
+     * @param Kp The proportional gain.
+     * @param Ki The integral gain.
+     * @param Kd The derivative gain.
+     */
+    void setGains(int i, float Kp, float Ki, float Kd)
+    {
+        this->Kp[i] = Kp;
+        this->Ki[i] = Ki;
+        this->Kd[i] = Kd;
+    }
+
+    /**
+     * @brief Set the output and integral limit of one channel, the minmax of PID::calculate.
+     *
+     * @param i The channel.
+     * @param minmax The output is clamped to [-minmax, minmax].
+     */
+    void setLimit(int i, float minmax)
+    {
+        limit[i] = minmax;
+    }
+
+    /**
+     * @brief Set how long the bank may be idle before the integrals and errors are cleared.
+     *
+     * @param timeout_ns The idle time in nanoseconds, 2 s by default like PID.
+     */
+    void setResetTimeout(uint64_t timeout_ns)
+    {
+        reset_timeout_ns = timeout_ns;
+    }
+
+    /**
+     * @brief Clear the integral and last error of every channel.
+     *
+     */
+    void reset()
+    {
+        std::fill(integral.begin(), integral.end(), 0.0f);
+        std::fill(last_error.begin(), last_error.end(), 0.0f);
+    }
+
+    /**
+     * @brief Calculate the outputs of every channel.
+     *
+     * @param error The errors, one per channel.
+     * @param output The outputs, one per channel.
+     * @param t_ns The time of this cycle in nanoseconds, e.g. MonotonicClock::now_ns().
+     */
+    void calculate(const float *error, float *output, uint64_t t_ns)
+    {
+        if (has_run && t_ns - last_call_ns > reset_timeout_ns)
+            reset();
+        has_run = true;
+        last_call_ns = t_ns;
+
+        const float *__restrict kp = Kp.data();
+        const float *__restrict ki = Ki.data();
+        const float *__restrict kd = Kd.data();
+        const float *__restrict lim = limit.data();
+        float *__restrict integ = integral.data();
+        float *__restrict last = last_error.data();
+        float *__restrict prop = proportional.data();
+        float *__restrict deriv = derivative.data();
+        const int n = size();
+
+        for (int i = 0; i < n; i++)
+        {
+            float e = error[i];
+            prop[i] = kp[i] * e;
+            deriv[i] = kd[i] * (e - last[i]);
+            last[i] = e;
+
+            float in = std::min(std::max(integ[i] + ki[i] * e, -lim[i]), lim[i]);
+            integ[i] = in;
+
+            output[i] = std::min(std::max(prop[i] + in + deriv[i], -lim[i]), lim[i]);
+        }
+    }
+
+    /**
+     * @brief Return the number of channels.
+     *
+     */
+    int size() const { return (int)Kp.size(); }
+
+    /**
+     * @brief Return the terms of one channel from the last calculate().
+     *
+     */
+    float getProportional(int i) const { return proportional[i]; }
+    float getIntegral(int i) const { return integral[i]; }
+    float getDerivative(int i) const { return derivative[i]; }
+
+private:
+    // Gains and limits
+    std::vector<float> Kp, Ki, Kd, limit;
+
+    // Controller state
+    std::vector<float> integral, last_error;
+
+    // Terms of the last calculate()
+    std::vector<float> proportional, derivative;
+
+    uint64_t reset_timeout_ns;
+    uint64_t last_call_ns;
+    bool has_run;
+};
+
+#endif // PID_BANK_H
@@ -0,0 +1,231 @@
+/**
+ * @file pid_controller.h
+ *
+ * @brief This file contains the PIDController class.
+ *
+ * Unlike PID, whose integral and derivative terms are per call, PIDController
+ * integrates and differentiates over the real elapsed time. The same gains
+ * then work at any loop rate, so a loop can run slower without retuning.
+ * On top of that it offers a low-pass filtered derivative, derivative on
+ * measurement, selectable anti-windup, output rate limiting and a
+ * feed-forward input.
+ */
+
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+#include "custom_time.h"
+
+#include <algorithm>
+
+/**
+ * @brief Anti-windup strategies.
+ *
+ * PID_ANTI_WINDUP_CLAMP stops integrating while the output is saturated in the direction of the error.
+ * PID_ANTI_WINDUP_BACK_CALCULATION bleeds the integral by Kb * (saturated - unsaturated output).
+ */
+enum PIDAntiWindup
+{
+    PID_ANTI_WINDUP_NONE,
+    PID_ANTI_WINDUP_CLAMP,
+    PID_ANTI_WINDUP_BACK_CALCULATION
+};
+
+/**
+ * @brief PIDController settings.
+ *
+ */
+typedef struct
+{
+    float Kp;                       // proportional gain
+    float Ki;                       // integral gain, per second
+    float Kd;                       // derivative gain, seconds
+    float min_out;                  // output limits
+    float max_out;
+    float derivative_tau;           // derivative low-pass time constant in seconds, 0 = unfiltered
+    bool derivative_on_measurement; // differentiate -measurement instead of the error, no kick on setpoint steps
+    PIDAntiWindup anti_windup;
+    float Kb;                       // back-calculation gain, per second
+    float max_rate;                 // output change per second, 0 = unlimited
+    float reset_timeout;            // seconds without a call before the state is cleared, 0 = never
+} pid_config_t;
+
+/**
+ * @brief Default PIDController settings: unfiltered derivative on error, clamping anti-windup, no rate limit.
+ *
+ * @param Kp The proportional gain.
+ * @param Ki The integral gain.
+ * @param Kd The derivative gain.
+ * @param minmax The output is limited to [-minmax, minmax].
+ * @return pid_config_t The settings.
+ */
+inline pid_config_t pid_config_default(float Kp, float Ki, float Kd, float minmax)
+{
+    pid_config_t config;
+    config.Kp = Kp;
+    config.Ki = Ki;
+    config.Kd = Kd;
+    config.min_out = -minmax;
+    config.max_out = minmax;
+    config.derivative_tau = 0;
+    config.derivative_on_measurement = false;
+    config.anti_windup = PID_ANTI_WINDUP_CLAMP;
+    config.Kb = Kp > 0 ? Ki / Kp : 0;
+    config.max_rate = 0;
+    config.reset_timeout = 2;
+    return config;
+}
+
+/**
+ * @brief A PID controller working on elapsed time.
+ *
+ * @tparam Clock The clock used when the caller does not pass dt, see custom_time.h.
+ */
+template <class Clock = MonotonicClock>
+class BasicPIDController
+{
+public:
+    /**
+     * @brief Construct a new PIDController object.
+     *
+     * @param config The settings, see pid_config_default().
+     */
+    BasicPIDController(const pid_config_t &config) : config(config), last_call_ns(0)
+    {
+        reset();
+    }
+
+    /**
+     * @brief Clear the controller state.
+     *
+     */
+    void reset()
+    {
+        integral = 0;
+        derivative_filtered = 0;
+        last_error = 0;
+        last_measurement = 0;
+        proportional = 0;
+        derivative = 0;
+        output = 0;
+        has_run = false;
+    }
+
+    /**
+     * @brief Calculate the output with dt measured on the clock.
+     *
+     * @param setpoint The setpoint.
+     * @param measurement The measurement.
+     * @param feed_forward Added to the output before limiting.
+     * @return float The output.
+     */
+    float calculate(float setpoint, float measurement, float feed_forward = 0)
+    {
+        uint64_t t_now = Clock::now_ns();
+        float dt = has_run ? (t_now - last_call_ns) * 1.0e-9f : 0;
+        last_call_ns = t_now;
+        return calculate(setpoint, measurement, feed_forward, dt);
+    }
+
+    /**
+     * @brief Calculate the output for a step of dt seconds.
+     *
+     * @param setpoint The setpoint.
+     * @param measurement The measurement.
+     * @param feed_forward Added to the output before limiting.
+     * @param dt The time since the previous call in seconds.
+     * @return float The output.
+     */
+    float calculate(float setpoint, float measurement, float feed_forward, float dt)
+    {
+        if (has_run && config.reset_timeout > 0 && dt > config.reset_timeout)
+            reset();
+        if (!has_run)
+        {
+            dt = 0;
+            last_error = setpoint - measurement;
+            last_measurement = measurement;
+            last_output = output;
+        }
+        has_run = true;
+
+        float error = setpoint - measurement;
+        proportional = config.Kp * error;
+
+        if (dt > 0)
+        {
+            float slope = config.derivative_on_measurement ? (last_measurement - measurement) / dt : (error - last_error) / dt;
+            float alpha = dt / (config.derivative_tau + dt);
+            derivative_filtered += alpha * (slope - derivative_filtered);
+        }
+        derivative = config.Kd * derivative_filtered;
+        last_error = error;
+        last_measurement = measurement;
+
+        float increment = config.Ki * error * dt;
+        integral += increment;
+
+        float unsaturated = proportional + integral + derivative + feed_forward;
+        output = std::min(std::max(unsaturated, config.min_out), config.max_out);
+
+        if (config.anti_windup == PID_ANTI_WINDUP_CLAMP)
+        {
+            if ((unsaturated > config.max_out && increment > 0) || (unsaturated < config.min_out && increment < 0))
+                integral -= increment;
+            integral = std::min(std::max(integral, config.min_out), config.max_out);
+        }
+
+        if (config.max_rate > 0 && dt > 0)
+        {
+            float step = config.max_rate * dt;
+            output = std::min(std::max(output, last_output - step), last_output + step);
+        }
+
+        if (config.anti_windup == PID_ANTI_WINDUP_BACK_CALCULATION)
+            integral += config.Kb * (output - unsaturated) * dt;
+
+        last_output = output;
+        return output;
+    }
+
+    /**
+     * @brief Change the settings, the state is kept.
+     *
+     */
+    void setConfig(const pid_config_t &config) { this->config = config; }
+    const pid_config_t &getConfig() const { return config; }
+
+    /**
+     * @brief Return the terms of the last calculate().
+     *
+     */
+    float getProportional() const { return proportional; }
+    float getIntegral() const { return integral; }
+    float getDerivative() const { return derivative; }
+    float getOutput() const { return output; }
+
+private:
+    pid_config_t config;
+
+    // Controller state
+    float integral;
+    float derivative_filtered;
+    float last_error;
+    float last_measurement;
+    float last_output;
+    uint64_t last_call_ns;
+    bool has_run;
+
+    // Terms of the last calculate()
+    float proportional;
+    float derivative;
+    float output;
+};
+
+/**
+ * @brief The PIDController class on the monotonic clock.
+ *
+ */
+typedef BasicPIDController<> PIDController;
+
+#endif // PID_CONTROLLER_H
@@ -0,0 +1,492 @@
+/**
+ * @file polygon_zone.h
+ *
+ * @brief This file contains the PolygonZone and ZoneIndex classes.
+ *
+ * A PolygonZone is an arbitrary simple or self-intersecting polygon (field
+ * areas, goal boxes, keep-out zones) with its edges precomputed for a
+ * winding-number point test. The test is built on orient2d(), which
+ * returns the exact sign of the orientation determinant: every float
+ * product fits in a double, so the determinant is filtered in double and
+ * only recomputed as an exact sum when it is too close to zero to tell.
+ * Points on an edge or vertex are reported as POLYGON_BOUNDARY instead of
+ * landing on either side by rounding.
+ *
+ * A ZoneIndex answers "which zone contains this point" over many zones
+ * with a uniform grid. Each cell lists the zones that overlap it and
+ * marks the ones covering the whole cell, so most queries are one cell
+ * lookup and at most a few edge tests, whatever the number of zones.
+ *
+ * @code{.cpp}
+ * ZoneIndex zones;
+ * const point2d_t penalty[] = {{0, 0}, {2, 0}, {2, 4}, {0, 4}};
+ * int penalty_id = zones.add(penalty, 4);
+ * ...
+ * zones.build(0.25);
+ * int zone = zones.find(robot);  // -1 outside every zone
+ * @endcode
+ */
+
+#ifndef POLYGON_ZONE_H
+#define POLYGON_ZONE_H
+
+#include "custom_typedef.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Where a point is relative to a polygon.
+ *
+ */
+enum PolygonLocation
+{
+    POLYGON_OUTSIDE,
+    POLYGON_INSIDE,
+    POLYGON_BOUNDARY
+};
+
+// The predicates below rely on every operation being rounded separately
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/**
+ * @brief Add two doubles exactly: x + y == a + b, x = fl(a + b).
+ *
+ */
+inline void two_sum(double a, double b, double &x, double &y)
+{
+    x = a + b;
+    double b_virtual = x - a;
+    double a_virtual = x - b_virtual;
+    y = (a - a_virtual) + (b - b_virtual);
+}
+
+/**
+ * @brief Return the exact sign of the sum of some doubles.
+ *
+ * The terms are accumulated into a nonoverlapping expansion, whose sign is
+ * the sign of its largest nonzero component.
+ *
+ * @param terms The terms.
+ * @param n The number of terms, at most 8.
+ * @return int -1, 0 or 1.
+ */
+inline int exact_sum_sign(const double *terms, int n)
+{
+    double e[8];
+    int m = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double q = terms[i];
+        for (int j = 0; j < m; j++)
+            two_sum(q, e[j], q, e[j]);
+        e[m++] = q;
+    }
+    for (int j = m - 1; j >= 0; j--)
+        if (e[j] != 0)
+            return e[j] > 0 ? 1 : -1;
+    return 0;
+}
+
+/**
+ * @brief Return the exact orientation of c relative to the line a->b.
+ *
+ * Exact for any float coordinates whose products neither overflow nor
+ * underflow a double.
+ *
+ * @return int 1 if c is left of a->b (counter-clockwise), -1 if right, 0 if collinear.
+ */
+inline int orient2d(float ax, float ay, float bx, float by, float cx, float cy)
+{
+    double det_left = ((double)ax - cx) * ((double)by - cy);
+    double det_right = ((double)ay - cy) * ((double)bx - cx);
+    double det = det_left - det_right;
+
+    // Shewchuk's ccwerrboundA
+    double bound = 3.3306690738754716e-16 * (fabs(det_left) + fabs(det_right));
+    if (det > bound)
+        return 1;
+    if (-det > bound)
+        return -1;
+
+    // bx*cy - bx*ay - ax*cy - by*cx + by*ax + ay*cx, each product exact
+    const double terms[6] = {
+        (double)bx * cy, -(double)bx * ay, -(double)ax * cy,
+        -(double)by * cx, (double)by * ax, (double)ay * cx};
+    return exact_sum_sign(terms, 6);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+/**
+ * @brief Return the exact orientation of c relative to the line a->b.
+ *
+ */
+inline int orient2d(point2d_t a, point2d_t b, point2d_t c)
+{
+    return orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+
+/**
+ * @brief A polygon edge with its bounds, precomputed for point tests.
+ *
+ */
+typedef struct
+{
+    float ax, ay;
+    float bx, by;
+    float xmin, xmax;
+    float ymin, ymax;
+} polygon_edge_t;
+
+/**
+ * @brief A polygon with precomputed edges.
+ *
+ */
+class PolygonZone
+{
+public:
+    /**
+     * @brief Construct a new PolygonZone object.
+     *
+     * @param vertices The vertices, in either winding order; the last one connects back to the first.
+     * @param n The number of vertices, at least 3.
+     */
+    PolygonZone(const point2d_t *vertices, int n)
+    {
+        edges.resize(n);
+        xmin = xmax = vertices[0].x;
+        ymin = ymax = vertices[0].y;
+        double twice_area = 0;
+        for (int i = 0; i < n; i++)
+        {
+            point2d_t a = vertices[i];
+            point2d_t b = vertices[(i + 1) % n];
+            polygon_edge_t &e = edges[i];
+            e.ax = a.x;
+            e.ay = a.y;
+            e.bx = b.x;
+            e.by = b.y;
+            e.xmin = fminf(a.x, b.x);
+            e.xmax = fmaxf(a.x, b.x);
+            e.ymin = fminf(a.y, b.y);
+            e.ymax = fmaxf(a.y, b.y);
+
+            xmin = fminf(xmin, a.x);
+            xmax = fmaxf(xmax, a.x);
+            ymin = fminf(ymin, a.y);
+            ymax = fmaxf(ymax, a.y);
+            twice_area += (double)a.x * b.y - (double)b.x * a.y;
+        }
+        signed_area = (float)(twice_area / 2);
+    }
+
+    /**
+     * @brief Locate a point with the nonzero winding rule.
+     *
+     * @return PolygonLocation POLYGON_BOUNDARY if the point is exactly on an edge.
+     */
+    PolygonLocation locate(float x, float y) const
+    {
+        if (x < xmin || x > xmax || y < ymin || y > ymax)
+            return POLYGON_OUTSIDE;
+
+        int winding = 0;
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            const polygon_edge_t &e = edges[i];
+            if (y < e.ymin || y > e.ymax || x > e.xmax)
+                continue;
+
+            bool up = e.ay <= y && e.by > y;
+            bool down = e.by <= y && e.ay > y;
+
+            // Wholly right of the point: it crosses the ray unless it only touches it
+            if (x < e.xmin)
+            {
+                winding += up - down;
+                continue;
+            }
+
+            int o = orient2d(e.ax, e.ay, e.bx, e.by, x, y);
+            if (o == 0)
+                return POLYGON_BOUNDARY;
+            if (up && o > 0)
+                winding++;
+            else if (down && o < 0)
+                winding--;
+        }
+        return winding != 0 ? POLYGON_INSIDE : POLYGON_OUTSIDE;
+    }
+
+    /**
+     * @brief Locate a point with the nonzero winding rule.
+     *
+     */
+    PolygonLocation locate(point2d_t p) const { return locate(p.x, p.y); }
+
+    /**
+     * @brief Check if a point is inside the polygon or on its boundary.
+     *
+     */
+    bool contains(point2d_t p) const { return locate(p.x, p.y) != POLYGON_OUTSIDE; }
+
+    /**
+     * @brief Return the signed area, positive for counter-clockwise vertices.
+     *
+     */
+    float getSignedArea() const { return signed_area; }
+
+    /**
+     * @brief Return the precomputed edges.
+     *
+     */
+    const std::vector<polygon_edge_t> &getEdges() const { return edges; }
+
+    /** @brief The bounding box. */
+    float xmin, xmax, ymin, ymax;
+
+private:
+    std::vector<polygon_edge_t> edges;
+    float signed_area;
+};
+
+/**
+ * @brief A uniform grid index over many polygon zones.
+ *
+ * Zones may overlap; queries return the lowest zone id first.
+ */
+class ZoneIndex
+{
+public:
+    ZoneIndex() : built(false), nx(0), ny(0), x0(0), y0(0), cell(1), inv_cell(1) {}
+
+    /**
+     * @brief Add a zone. Invalidates the grid until the next build().
+     *
+     * @return int The zone id, counting from 0.
+     */
+    int add(const point2d_t *vertices, int n)
+    {
+        zones.push_back(PolygonZone(vertices, n));
+        built = false;
+        return (int)zones.size() - 1;
+    }
+
+    /**
+     * @brief Build the grid.
+     *
+     * @param cell_size The cell size, 0 to pick one from the number of edges.
+     */
+    void build(float cell_size = 0)
+    {
+        cell_start.clear();
+        entries.clear();
+        built = false;
+        if (zones.empty())
+            return;
+
+        float x1 = zones[0].xmax, y1 = zones[0].ymax;
+        size_t num_edges = 0;
+        x0 = zones[0].xmin;
+        y0 = zones[0].ymin;
+        for (size_t z = 0; z < zones.size(); z++)
+        {
+            x0 = fminf(x0, zones[z].xmin);
+            y0 = fminf(y0, zones[z].ymin);
+            x1 = fmaxf(x1, zones[z].xmax);
+            y1 = fmaxf(y1, zones[z].ymax);
+            num_edges += zones[z].getEdges().size();
+        }
+        float w = x1 - x0, h = y1 - y0;
+
+        // About four cells per edge by default, at most a million
+        if (cell_size <= 0)
+            cell_size = sqrtf(w * h / (4.0f * num_edges));
+        if (!(cell_size > 0))
+            cell_size = fmaxf(fmaxf(w, h), 1.0f);
+        while ((w / cell_size + 1) * (h / cell_size + 1) > (1 << 20))
+            cell_size *= 2;
+
+        cell = cell_size;
+        inv_cell = 1.0f / cell_size;
+        nx = (int)(w * inv_cell) + 1;
+        ny = (int)(h * inv_cell) + 1;
+
+        std::vector<std::vector<int32_t>> lists((size_t)nx * ny);
+        std::vector<uint8_t> crossed;
+        // Cells are widened so a point rounded into the neighbouring cell is still covered
+        const float margin = cell * 1e-3f;
+        for (size_t z = 0; z < zones.size(); z++)
+        {
+            const PolygonZone &zone = zones[z];
+            int cx0 = cellX(zone.xmin - margin), cx1 = cellX(zone.xmax + margin);
+            int cy0 = cellY(zone.ymin - margin), cy1 = cellY(zone.ymax + margin);
+            int cw = cx1 - cx0 + 1;
+
+            // Mark the cells an edge may pass through
+            crossed.assign((size_t)cw * (cy1 - cy0 + 1), 0);
+            const std::vector<polygon_edge_t> &edges = zone.getEdges();
+            for (size_t i = 0; i < edges.size(); i++)
+            {
+                const polygon_edge_t &e = edges[i];
+                for (int cy = cellY(e.ymin - margin); cy <= cellY(e.ymax + margin); cy++)
+                    for (int cx = cellX(e.xmin - margin); cx <= cellX(e.xmax + margin); cx++)
+                        crossed[(size_t)(cy - cy0) * cw + (cx - cx0)] = 1;
+            }
+
+            // Cells without an edge are wholly inside or wholly outside; the centre tells which
+            for (int cy = cy0; cy <= cy1; cy++)
+                for (int cx = cx0; cx <= cx1; cx++)
+                {
+                    std::vector<int32_t> &list = lists[(size_t)cy * nx + cx];
+                    if (crossed[(size_t)(cy - cy0) * cw + (cx - cx0)])
+                        list.push_back((int32_t)z << 1);
+                    else if (zone.locate(x0 + (cx + 0.5f) * cell, y0 + (cy + 0.5f) * cell) == POLYGON_INSIDE)
+                        list.push_back((int32_t)z << 1 | 1);
+                }
+        }
+
+        cell_start.resize(lists.size() + 1);
+        cell_start[0] = 0;
+        for (size_t c = 0; c < lists.size(); c++)
+        {
+            entries.insert(entries.end(), lists[c].begin(), lists[c].end());
+            cell_start[c + 1] = (uint32_t)entries.size();
+        }
+        built = true;
+    }
+
+    /**
+     * @brief Find the lowest zone id containing a point.
+     *
+     * Falls back to testing every zone if the grid is not built.
+     *
+     * @param p The point.
+     * @param boundary True to count a point on an edge as inside.
+     * @return int The zone id, -1 if there is none.
+     */
+    int find(point2d_t p, bool boundary = true) const
+    {
+        if (!built)
+        {
+            for (size_t z = 0; z < zones.size(); z++)
+                if (isIn(zones[z].locate(p), boundary))
+                    return (int)z;
+            return -1;
+        }
+
+        int c = cellOf(p);
+        if (c < 0)
+            return -1;
+        for (uint32_t i = cell_start[c]; i < cell_start[c + 1]; i++)
+        {
+            int32_t entry = entries[i];
+            if ((entry & 1) || isIn(zones[entry >> 1].locate(p), boundary))
+                return entry >> 1;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Find the zone of many points.
+     *
+     * @param points The points.
+     * @param n The number of points.
+     * @param zone The zone ids, -1 outside every zone, n ints.
+     * @param boundary True to count a point on an edge as inside.
+     */
+    void find(const point2d_t *points, size_t n, int *zone, bool boundary = true) const
+    {
+        for (size_t i = 0; i < n; i++)
+            zone[i] = find(points[i], boundary);
+    }
+
+    /**
+     * @brief Find every zone containing a point.
+     *
+     * @param p The point.
+     * @param out The zone ids, in increasing order; cleared first.
+     * @param boundary True to count a point on an edge as inside.
+     * @return size_t The number of zones.
+     */
+    size_t findAll(point2d_t p, std::vector<int> &out, bool boundary = true) const
+    {
+        out.clear();
+        if (!built)
+        {
+            for (size_t z = 0; z < zones.size(); z++)
+                if (isIn(zones[z].locate(p), boundary))
+                    out.push_back((int)z);
+            return out.size();
+        }
+
+        int c = cellOf(p);
+        if (c < 0)
+            return 0;
+        for (uint32_t i = cell_start[c]; i < cell_start[c + 1]; i++)
+        {
+            int32_t entry = entries[i];
+            if ((entry & 1) || isIn(zones[entry >> 1].locate(p), boundary))
+                out.push_back(entry >> 1);
+        }
+        return out.size();
+    }
+
+    /**
+     * @brief Return a zone.
+     *
+     */
+    const PolygonZone &getZone(int id) const { return zones[id]; }
+
+    /**
+     * @brief Return the number of zones.
+     *
+     */
+    size_t size() const { return zones.size(); }
+
+private:
+    std::vector<PolygonZone> zones;
+    bool built;
+
+    // Grid: the entries of cell c are entries[cell_start[c] .. cell_start[c + 1]), each zone << 1 | covers_cell
+    int nx, ny;
+    float x0, y0, cell, inv_cell;
+    std::vector<uint32_t> cell_start;
+    std::vector<int32_t> entries;
+
+    static bool isIn(PolygonLocation location, bool boundary)
+    {
+        return location == POLYGON_INSIDE || (boundary && location == POLYGON_BOUNDARY);
+    }
+
+    int cellX(float x) const
+    {
+        int c = (int)floorf((x - x0) * inv_cell);
+        return c < 0 ? 0 : (c >= nx ? nx - 1 : c);
+    }
+
+    int cellY(float y) const
+    {
+        int c = (int)floorf((y - y0) * inv_cell);
+        return c < 0 ? 0 : (c >= ny ? ny - 1 : c);
+    }
+
+    int cellOf(point2d_t p) const
+    {
+        float fx = floorf((p.x - x0) * inv_cell);
+        float fy = floorf((p.y - y0) * inv_cell);
+        if (!(fx >= 0 && fx < nx && fy >= 0 && fy < ny))
+            return -1;
+        return (int)fy * nx + (int)fx;
+    }
+};
+
+#endif // POLYGON_ZONE_H
@@ -0,0 +1,233 @@
+/**
+ * @file rate_loop.h
+ *
+ * @brief This file contains the RateLoop class and real-time thread helpers.
+ *
+ * RateLoop paces a control loop against absolute deadlines, so the period
+ * does not drift with the time spent in the loop body, and keeps statistics
+ * about how late each cycle woke up and how many cycles overran.
+ *
+ * @code{.cpp}
+ * #include "rate_loop.h"
+ *
+ * int main()
+ * {
+ *     set_thread_realtime(80);
+ *     pin_thread_to_cpu(3);
+ *
+ *     RateLoop<> loop(1000.0, 20000); // 1 kHz, spin the last 20 us
+ *     while (running)
+ *     {
+ *         output = pid.calculate(error, 100);
+ *         loop.wait();
+ *     }
+ *     printf("overruns %u, max latency %llu ns\n", loop.stats().overruns, loop.stats().max_latency_ns);
+ * }
+ * @endcode
+ */
+
+#ifndef RATE_LOOP_H
+#define RATE_LOOP_H
+
+#include "custom_time.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * @brief The number of latency and overrun histogram bins.
+ *
+ * Bin 0 counts values under 1 us, bin k counts [2^(k-1), 2^k) us and the last bin everything above.
+ */
+#define RATE_LOOP_HIST_BINS 16
+
+/**
+ * @brief Run the calling thread with SCHED_FIFO.
+ *
+ * @param priority The real-time priority, 1 to 99.
+ * @return bool True on success, false if not permitted (needs CAP_SYS_NICE or an rtprio limit).
+ */
+inline bool set_thread_realtime(int priority)
+{
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+/**
+ * @brief Pin the calling thread to one CPU.
+ *
+ * @param cpu The CPU index.
+ * @return bool True on success.
+ */
+inline bool pin_thread_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * @brief Statistics collected by RateLoop.
+ *
+ */
+typedef struct
+{
+    uint32_t cycles;          // completed wait() calls
+    uint32_t overruns;        // cycles whose body ran past the deadline
+    uint32_t missed;          // deadlines skipped because of overruns
+    uint64_t max_latency_ns;  // latest wake-up after a deadline
+    uint64_t sum_latency_ns;  // for the mean latency
+    uint64_t max_exec_ns;     // longest loop body
+    uint32_t latency_hist[RATE_LOOP_HIST_BINS]; // wake-up latency of on-time cycles
+    uint32_t overrun_hist[RATE_LOOP_HIST_BINS]; // how far past the deadline an overrun ended
+} rate_loop_stats_t;
+
+/**
+ * @brief A fixed-rate loop pacer.
+ *
+ * @tparam Clock The clock, see custom_time.h. With SimulatedClock wait() just advances the time
+ *         to the deadline and spin_ns is ignored.
+ */
+template <class Clock = MonotonicClock>
+class RateLoop
+{
+public:
+    /**
+     * @brief Construct a new RateLoop object. The first deadline is one period from now.
+     *
+     * @param rate_hz The loop rate.
+     * @param spin_ns Sleep until this long before the deadline and busy-wait the rest, 0 to only sleep.
+     */
+    RateLoop(double rate_hz, uint64_t spin_ns = 0)
+        : period(1.0e9 / rate_hz), spin(spin_ns)
+    {
+        resetStats();
+        start();
+    }
+
+    /**
+     * @brief Restart the schedule, the next deadline is one period from now.
+     *
+     */
+    void start()
+    {
+        last_wake = Clock::now_ns();
+        deadline = last_wake + period;
+    }
+
+    /**
+     * @brief Wait for the next deadline. Call it once at the end of every cycle.
+     *
+     * If the body overran, the cycle is counted and the schedule skips to the
+     * next deadline still in the future instead of bursting to catch up.
+     *
+     * @return uint64_t The wake-up time in nanoseconds.
+     */
+    uint64_t wait()
+    {
+        uint64_t t_now = Clock::now_ns();
+        uint64_t exec = t_now - last_wake;
+        if (exec > stat.max_exec_ns)
+            stat.max_exec_ns = exec;
+
+        if (t_now >= deadline)
+        {
+            uint64_t late = (t_now - deadline) / period;
+            stat.overruns++;
+            stat.overrun_hist[bin(t_now - deadline)]++;
+            stat.missed += late;
+            deadline += (late + 1) * period;
+            last_wake = t_now;
+            stat.cycles++;
+            return t_now;
+        }
+
+        if (std::is_same<Clock, SimulatedClock>::value)
+        {
+            // a simulated clock only moves when slept on, so never spin on it
+            Clock::sleep_until_ns(deadline);
+            t_now = Clock::now_ns();
+        }
+        else
+        {
+            if (deadline - t_now > spin)
+                Clock::sleep_until_ns(deadline - spin);
+            do
+                t_now = Clock::now_ns();
+            while (t_now < deadline);
+        }
+
+        record(t_now - deadline);
+        last_wake = t_now;
+        deadline += period;
+        stat.cycles++;
+        return t_now;
+    }
+
+    /**
+     * @brief Return the period in nanoseconds.
+     *
+     */
+    uint64_t period_ns() const { return period; }
+
+    /**
+     * @brief Return the collected statistics.
+     *
+     */
+    const rate_loop_stats_t &stats() const { return stat; }
+
+    /**
+     * @brief Return the mean wake-up latency in nanoseconds.
+     *
+     */
+    uint64_t meanLatency() const
+    {
+        uint32_t n = stat.cycles - stat.overruns;
+        return n ? stat.sum_latency_ns / n : 0;
+    }
+
+    /**
+     * @brief Clear the statistics.
+     *
+     */
+    void resetStats()
+    {
+        memset(&stat, 0, sizeof(stat));
+    }
+
+private:
+    void record(uint64_t latency)
+    {
+        stat.sum_latency_ns += latency;
+        if (latency > stat.max_latency_ns)
+            stat.max_latency_ns = latency;
+
+        stat.latency_hist[bin(latency)]++;
+    }
+
+    static int bin(uint64_t ns)
+    {
+        uint64_t us = ns / 1000;
+        int b = 0;
+        while (us && b < RATE_LOOP_HIST_BINS - 1)
+        {
+            us >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    uint64_t period;
+    uint64_t spin;
+    uint64_t deadline;
+    uint64_t last_wake;
+    rate_loop_stats_t stat;
+};
+
+#endif // RATE_LOOP_H
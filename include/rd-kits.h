@@ -12,13 +12,32 @@
  *
  * @section features_sec Features
  * The custom libraries provide the following features:
- * - Extended math functions
+ * - Extended math functions (SIMD batch geometry kernels)
+ * - Fast trigonometry, angle wrapping and SE(2) transforms
+ * - Polygon zones with exact point tests and a grid index
+ * - Spatial indexes for nearest-neighbour queries
  * - Keyboard input functions
  * - PID controller
+ * - PID controller bank
+ * - Time-aware PID controller
  * - Simple finite state machine
+ * - Table-driven compile-time state machine
+ * - Hierarchical state machine runtime
+ * - State machine transition tracing
  * - Standard Kalman filter
+ * - Kalman filter bank
+ * - Kalman filter history (out-of-sequence measurements)
+ * - Extended and Unscented Kalman filters
+ * - Multi-object tracker
+ * - Wheel odometry
  * - Custom time functions
+ * - Fixed-rate loop
+ * - Multi-rate task executor
  * - Custom typedefs
+ * - Asynchronous logger
+ * - Telemetry recorder
+ * - Deterministic log replay
+ * - Lock-free queues
  *
  *
  *
@@ -43,11 +62,32 @@
 #define RD_KITS_H
 
 #include "custom_time.h"
+#include "rate_loop.h"
+#include "task_executor.h"
 #include "custom_typedef.h"
 #include "extended_math.h"
+#include "fast_trig.h"
+#include "polygon_zone.h"
+#include "spatial_index.h"
 #include "pid.h"
+#include "pid_bank.h"
+#include "pid_controller.h"
 #include "simple_fsm.h"
+#include "static_fsm.h"
+#include "fsm_runtime.h"
+#include "fsm_trace.h"
 #include "keyboard_input.h"
 #include "standard_kf.h"
+#include "kf_bank.h"
+#include "kf_history.h"
+#include "extended_kf.h"
+#include "unscented_kf.h"
+#include "mot_tracker.h"
+#include "odometry.h"
+#include "spsc_queue.h"
+#include "mpsc_queue.h"
+#include "async_log.h"
+#include "telemetry.h"
+#include "replay.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+/**
+ * @file replay.h
+ *
+ * @brief This file contains the Replay harness.
+ *
+ * A Replay streams a recorded telemetry log (telemetry.h) record by record,
+ * in file order, and sets the calling thread's SimulatedClock to each
+ * record's timestamp before handing it to the callback. Filters fed the
+ * record time (KalmanFilter::predict/correct, KF_update) and components
+ * built on SimulatedClock (PIDController, StaticMachine, RateLoop, ...) then
+ * see exactly the recorded timeline, as fast as the CPU allows and with the
+ * same result on every run. SimulatedClock is per thread, so
+ * replay_parallel() can run many replays on many cores at once.
+ *
+ * @code{.cpp}
+ * // Recording, in the robot
+ * static const char *names[] = {"x", "y"};
+ * static const uint8_t types[] = {TELEMETRY_F64, TELEMETRY_F64};
+ * int gps = log.addStream("gps", names, types, 2);
+ * ...
+ * double xy[2] = {x, y};
+ * log.write(gps, MonotonicClock::now_ns(), xy);
+ *
+ * // Replaying, offline
+ * std::vector<std::string> logs = {"a.tlm", "b.tlm"};
+ * std::vector<uint64_t> digests(logs.size());
+ * replay_parallel(logs, 0, [&](size_t i, Replay &replay)
+ * {
+ *     KalmanFilter<4, 2> kf(...);
+ *     ReplayDigest digest;
+ *     int gps = replay.findStream("gps");
+ *     replay.run([&](const ReplayRecord &r)
+ *     {
+ *         if (r.stream != gps)
+ *             return;
+ *         kf.correct(Eigen::Vector2d(r.get(0), r.get(1)), r.t_ns * 1e-9);
+ *         digest.add(kf.state().data(), sizeof(double) * 4);
+ *     });
+ *     digests[i] = digest.value();
+ * });
+ * @endcode
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "custom_time.h"
+#include "telemetry.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One record handed to a replay callback.
+ *
+ */
+struct ReplayRecord
+{
+    int stream;
+    uint64_t t_ns;        // replay time, never behind an earlier record
+    uint64_t logged_t_ns; // timestamp as written to the log
+    const uint8_t *payload;
+    const TelemetryReader::Stream *desc;
+
+    /**
+     * @brief Return field i as a double.
+     *
+     */
+    double get(int i) const { return TelemetryReader::field(desc->fields[i], payload); }
+
+    /**
+     * @brief Return the number of fields.
+     *
+     */
+    int size() const { return desc->desc->num_fields; }
+};
+
+/**
+ * @brief A replay of one telemetry log on the calling thread.
+ *
+ */
+class Replay
+{
+public:
+    /**
+     * @brief Open a log.
+     *
+     * @param path The telemetry log.
+     * @return bool False if it is not a telemetry log.
+     */
+    bool open(const char *path)
+    {
+        return reader.open(path);
+    }
+
+    /**
+     * @brief Find a stream by name.
+     *
+     * @return int The stream id, -1 if there is none.
+     */
+    int findStream(const char *name) const { return reader.findStream(name); }
+
+    /**
+     * @brief Stream every record to a callback, with SimulatedClock set to the record time.
+     *
+     * Writer threads stamp a record before reserving its place in the log,
+     * so records from different threads can be slightly out of time order
+     * in the file. The replay time is clamped to never go backwards: such a
+     * record is delivered in file order with t_ns equal to the latest time
+     * seen so far, and its own timestamp in logged_t_ns. Consumers therefore
+     * never see a negative dt.
+     *
+     * @param callback Called as callback(const ReplayRecord &).
+     * @param speed 0 to run as fast as possible, otherwise the playback rate (1 = real time) on MonotonicClock.
+     * @return long The number of records replayed.
+     */
+    template <class Callback>
+    long run(Callback &&callback, double speed = 0)
+    {
+        const std::vector<TelemetryReader::Stream> &streams = reader.getStreams();
+        size_t offset = reader.begin();
+        const telemetry_record_t *r;
+        const uint8_t *payload;
+        uint64_t t0 = 0, wall0 = 0, t = 0;
+        long n = 0;
+
+        while (reader.next(offset, r, payload))
+        {
+            if (n == 0)
+            {
+                t0 = t = r->t_ns;
+                wall0 = MonotonicClock::now_ns();
+            }
+            t = std::max(t, r->t_ns);
+            if (speed > 0)
+                MonotonicClock::sleep_until_ns(wall0 + (uint64_t)((t - t0) / speed));
+
+            SimulatedClock::set_ns(t);
+            ReplayRecord record = {r->stream, t, r->t_ns, payload, &streams[r->stream]};
+            callback(record);
+            n++;
+        }
+        return n;
+    }
+
+private:
+    TelemetryReader reader;
+};
+
+/**
+ * @brief A running FNV-1a hash of replay outputs, to check that two runs are bit-identical.
+ *
+ */
+class ReplayDigest
+{
+public:
+    ReplayDigest() : hash(14695981039346656037ULL) {}
+
+    /**
+     * @brief Add raw bytes, e.g. a filter state.
+     *
+     */
+    void add(const void *data, size_t size)
+    {
+        const uint8_t *p = (const uint8_t *)data;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+
+    /**
+     * @brief Return the hash.
+     *
+     */
+    uint64_t value() const { return hash; }
+
+private:
+    uint64_t hash;
+};
+
+/**
+ * @brief Replay many logs in parallel, each on one thread with its own SimulatedClock.
+ *
+ * @param paths The telemetry logs.
+ * @param threads The number of threads, 0 for one per core.
+ * @param job Called as job(size_t index, Replay &replay) with the log already opened; logs that fail to open are skipped.
+ * @return size_t The number of logs replayed.
+ */
+template <class Job>
+size_t replay_parallel(const std::vector<std::string> &paths, unsigned threads, Job &&job)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, (unsigned)paths.size());
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> done(0);
+    auto work = [&]()
+    {
+        for (size_t i = next.fetch_add(1); i < paths.size(); i = next.fetch_add(1))
+        {
+            Replay replay;
+            if (!replay.open(paths[i].c_str()))
+                continue;
+            job(i, replay);
+            done.fetch_add(1);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(work);
+    if (threads > 0)
+        work();
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+    return done.load();
+}
+
+#endif // REPLAY_H
@@ -8,17 +8,28 @@
 #ifndef SIMPLE_FSM_H
 #define SIMPLE_FSM_H
 
+#include "custom_time.h"
+#include "fsm_trace.h"
+
 #include <chrono>
 
 /**
  * @brief The MachineState class.
  *
+ * @tparam Clock The clock used by the timers, see custom_time.h.
  */
-class MachineState
+template <class Clock = MonotonicClock>
+class BasicMachineState
 {
 public:
     /**
-     * @brief The value of the state.
+     * @brief The clock used by the timers.
+     *
+     */
+    typedef Clock clock_type;
+
+    /**
+     * @brief The value of the state. Writing it directly is not traced, see set().
      *
      */
     int16_t value;
@@ -39,25 +50,32 @@ public:
      * @brief The uptime timeout.
      *
      */
-    std::chrono::system_clock::time_point uptime_timeout;
+    typename Clock::time_point uptime_timeout;
 
     /**
      * @brief The uptime reentry.
      *
      */
-    std::chrono::system_clock::time_point uptime_reentry;
+    typename Clock::time_point uptime_reentry;
+
+    /**
+     * @brief The machine id recorded by FSM_TRACE, see fsm_trace.h.
+     *
+     */
+    uint32_t trace_id;
 
     /**
      * @brief Construct a new MachineState object.
      *
      */
-    MachineState()
+    BasicMachineState()
     {
         value = 0;
         intr_cntr = 0;
         prev_intr_cntr = 0;
-        uptime_timeout = std::chrono::high_resolution_clock::now();
-        uptime_reentry = std::chrono::high_resolution_clock::now();
+        trace_id = 0;
+        uptime_timeout = Clock::now();
+        uptime_reentry = uptime_timeout;
     }
 
     /**
@@ -76,7 +94,7 @@ public:
      */
     void resetUptimeTimeout()
     {
-        uptime_timeout = std::chrono::high_resolution_clock::now();
+        uptime_timeout = Clock::now();
     }
 
     /**
@@ -85,7 +103,18 @@ public:
      */
     void resetUptimeReentry()
     {
-        uptime_reentry = std::chrono::high_resolution_clock::now();
+        uptime_reentry = Clock::now();
+    }
+
+    /**
+     * @brief Change the state. The traced way to make a transition; a direct write to value is not recorded.
+     *
+     * @param target_state The target state.
+     */
+    void set(int16_t target_state)
+    {
+        FSM_TRACE(trace_id, value, target_state, FSM_TRACE_SET);
+        value = target_state;
     }
 
     /**
@@ -97,12 +126,13 @@ public:
      */
     void timeout(int16_t target_state, float period)
     {
-        std::chrono::high_resolution_clock::time_point t_now = std::chrono::high_resolution_clock::now();
+        typename Clock::time_point t_now = Clock::now();
         std::chrono::duration<double> elapsed_seconds = t_now - uptime_timeout;
         if (elapsed_seconds.count() > period)
         {
+            FSM_TRACE(trace_id, value, target_state, FSM_TRACE_TIMEOUT);
             value = target_state;
-            uptime_timeout = std::chrono::high_resolution_clock::now();
+            uptime_timeout = t_now;
         }
     }
 
@@ -115,14 +145,21 @@ public:
      */
     void reentry(int16_t target_state, float period)
     {
-        std::chrono::high_resolution_clock::time_point t_now = std::chrono::high_resolution_clock::now();
+        typename Clock::time_point t_now = Clock::now();
         std::chrono::duration<double> elapsed_seconds = t_now - uptime_reentry;
         if (elapsed_seconds.count() > period)
         {
+            FSM_TRACE(trace_id, value, target_state, FSM_TRACE_REENTRY);
             value = target_state;
         }
-        uptime_reentry = std::chrono::high_resolution_clock::now();
+        uptime_reentry = t_now;
     }
 };
 
+/**
+ * @brief The MachineState class on the monotonic clock.
+ *
+ */
+typedef BasicMachineState<> MachineState;
+
 #endif // SIMPLE_FSM_H
\ No newline at end of file
@@ -0,0 +1,668 @@
+/**
+ * @file spatial_index.h
+ *
+ * @brief This file contains the KdTree2D and GridIndex2D classes.
+ *
+ * Two spatial indexes over 2D points, to replace O(N*M) pythagoras() loops
+ * in nearest-obstacle and detection-to-track matching:
+ * - KdTree2D: a flat, implicit k-d tree. The points are reordered into
+ *   structure-of-arrays storage so a subtree is a contiguous range, and
+ *   every node keeps the bounding box of its range. Queries prune on the
+ *   boxes, not on the split lines, so when the points move a little between
+ *   frames refit() only recomputes the boxes in O(n) instead of
+ *   rebuilding.
+ * - GridIndex2D: a hashed uniform grid, counting-sorted into flat arrays.
+ *   Rebuilding it is O(n) with no allocation after the first build, which
+ *   suits points that all move every frame and queries with a known
+ *   radius.
+ *
+ * Both are built in bulk from x/y arrays, point2d_t or pose2d_t, answer
+ * k-nearest-neighbour and radius queries, and report the caller's original
+ * indices with squared distances.
+ *
+ * @code{.cpp}
+ * KdTree2D tree;
+ * tree.build(tracks_x, tracks_y, num_tracks);
+ * for (int i = 0; i < num_detections; i++)
+ *     match[i] = tree.nearest(det_x[i], det_y[i], gate * gate);
+ * ...
+ * tree.update(tracks_x, tracks_y);  // same points, moved
+ * if (tree.refit() > 2)
+ *     tree.build(tracks_x, tracks_y, num_tracks);
+ * @endcode
+ */
+
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "custom_typedef.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#ifndef SPATIAL_INDEX_LEAF_SIZE
+#define SPATIAL_INDEX_LEAF_SIZE 8
+#endif
+
+/**
+ * @brief An axis-aligned box.
+ *
+ */
+typedef struct
+{
+    float x0, y0;
+    float x1, y1;
+} box2d_t;
+
+/**
+ * @brief The k nearest points found so far, sorted by distance.
+ *
+ */
+class SpatialNearest
+{
+public:
+    SpatialNearest(int k, int *ids, float *dist2) : k(k), count(0), ids(ids), dist2(dist2) {}
+
+    /**
+     * @brief Return the distance a point must beat to be added.
+     *
+     */
+    float bound(float max_dist2) const { return count < k ? max_dist2 : dist2[k - 1]; }
+
+    void add(int id, float d2)
+    {
+        int i = count < k ? count++ : k - 1;
+        while (i > 0 && dist2[i - 1] > d2)
+        {
+            ids[i] = ids[i - 1];
+            dist2[i] = dist2[i - 1];
+            i--;
+        }
+        ids[i] = id;
+        dist2[i] = d2;
+    }
+
+    int k;
+    int count;
+    int *ids;
+    float *dist2;
+};
+
+/**
+ * @brief Return the squared distance from a point to a box, 0 inside.
+ *
+ */
+inline float box_dist2(const box2d_t &b, float x, float y)
+{
+    float dx = fmaxf(fmaxf(b.x0 - x, x - b.x1), 0.0f);
+    float dy = fmaxf(fmaxf(b.y0 - y, y - b.y1), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+/**
+ * @brief A flat, implicit 2D k-d tree with per-node bounding boxes.
+ *
+ */
+class KdTree2D
+{
+public:
+    KdTree2D() : n(0), built_area(0) {}
+
+    /**
+     * @brief Build the tree from x and y arrays.
+     *
+     * @param x The x coordinates.
+     * @param y The y coordinates.
+     * @param count The number of points; queries return indices into x and y.
+     */
+    void build(const float *x, const float *y, size_t count)
+    {
+        n = count;
+        ids.resize(n);
+        slots.resize(n);
+        xs.resize(n);
+        ys.resize(n);
+        boxes.resize(n);
+        dims.resize(n);
+        for (size_t i = 0; i < n; i++)
+            ids[i] = (int)i;
+
+        split(x, y, 0, n);
+
+        for (size_t s = 0; s < n; s++)
+        {
+            xs[s] = x[ids[s]];
+            ys[s] = y[ids[s]];
+            slots[ids[s]] = (int)s;
+        }
+        built_area = refitRange(0, n);
+    }
+
+    /**
+     * @brief Build the tree from points.
+     *
+     */
+    void build(const point2d_t *points, size_t count)
+    {
+        unpack(points, count);
+        build(tmp_x.data(), tmp_y.data(), count);
+    }
+
+    /**
+     * @brief Build the tree from poses, by position.
+     *
+     */
+    void build(const pose2d_t *poses, size_t count)
+    {
+        unpack(poses, count);
+        build(tmp_x.data(), tmp_y.data(), count);
+    }
+
+    /**
+     * @brief Move one point. Call refit() before the next query.
+     *
+     */
+    void setPoint(int id, float x, float y)
+    {
+        xs[slots[id]] = x;
+        ys[slots[id]] = y;
+    }
+
+    /**
+     * @brief Move every point, in the order given to build(). Call refit() before the next query.
+     *
+     */
+    void update(const float *x, const float *y)
+    {
+        for (size_t s = 0; s < n; s++)
+        {
+            xs[s] = x[ids[s]];
+            ys[s] = y[ids[s]];
+        }
+    }
+
+    /**
+     * @brief Recompute the node boxes after points moved, keeping the tree layout.
+     *
+     * @return float The total node box area relative to the last build; rebuild when it grows too much.
+     */
+    float refit()
+    {
+        float area = refitRange(0, n);
+        return built_area > 0 ? area / built_area : 1.0f;
+    }
+
+    /**
+     * @brief Find the nearest point.
+     *
+     * @param x The query x.
+     * @param y The query y.
+     * @param max_dist2 Only consider points closer than this squared distance.
+     * @param dist2 The squared distance to the point, if not NULL.
+     * @return int The point index, -1 if there is none.
+     */
+    int nearest(float x, float y, float max_dist2 = INFINITY, float *dist2 = NULL) const
+    {
+        int id = -1;
+        float d2 = max_dist2;
+        SpatialNearest best(1, &id, &d2);
+        if (n > 0)
+            searchKnn(0, n, x, y, max_dist2, best);
+        if (dist2 != NULL)
+            *dist2 = d2;
+        return best.count > 0 ? id : -1;
+    }
+
+    /**
+     * @brief Find the nearest point to each of many queries.
+     *
+     * @param x The query x coordinates.
+     * @param y The query y coordinates.
+     * @param m The number of queries.
+     * @param ids_out The point indices, -1 where there is none, m ints.
+     * @param dist2 The squared distances, m floats, or NULL.
+     * @param max_dist2 Only consider points closer than this squared distance.
+     */
+    void nearest(const float *x, const float *y, size_t m, int *ids_out, float *dist2 = NULL, float max_dist2 = INFINITY) const
+    {
+        for (size_t i = 0; i < m; i++)
+            ids_out[i] = nearest(x[i], y[i], max_dist2, dist2 != NULL ? &dist2[i] : NULL);
+    }
+
+    /**
+     * @brief Find the k nearest points.
+     *
+     * @param x The query x.
+     * @param y The query y.
+     * @param k The number of points wanted.
+     * @param ids_out The point indices, nearest first, k ints.
+     * @param dist2 The squared distances, k floats.
+     * @param max_dist2 Only consider points closer than this squared distance.
+     * @return int The number of points found, at most k.
+     */
+    int knn(float x, float y, int k, int *ids_out, float *dist2, float max_dist2 = INFINITY) const
+    {
+        SpatialNearest best(k, ids_out, dist2);
+        if (n > 0 && k > 0)
+            searchKnn(0, n, x, y, max_dist2, best);
+        return best.count;
+    }
+
+    /**
+     * @brief Find every point within a radius.
+     *
+     * @param x The query x.
+     * @param y The query y.
+     * @param radius The radius, inclusive.
+     * @param out The point indices, in no particular order; appended to.
+     * @return size_t The number of points found.
+     */
+    size_t radius(float x, float y, float radius, std::vector<int> &out) const
+    {
+        size_t before = out.size();
+        if (n > 0)
+            searchRadius(0, n, x, y, radius * radius, out);
+        return out.size() - before;
+    }
+
+    /**
+     * @brief Return the number of points.
+     *
+     */
+    size_t size() const { return n; }
+
+private:
+    size_t n;
+    float built_area;
+
+    // Slot s holds point ids[s]; the range [lo, hi) is a subtree whose node is slot (lo + hi) / 2, or lo for a leaf
+    std::vector<int> ids;
+    std::vector<int> slots;
+    std::vector<float> xs, ys;
+    std::vector<box2d_t> boxes;
+    std::vector<uint8_t> dims;
+    std::vector<float> tmp_x, tmp_y;
+
+    template <class Point>
+    void unpack(const Point *points, size_t count)
+    {
+        tmp_x.resize(count);
+        tmp_y.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            tmp_x[i] = points[i].x;
+            tmp_y[i] = points[i].y;
+        }
+    }
+
+    static bool isLeaf(size_t lo, size_t hi) { return hi - lo <= SPATIAL_INDEX_LEAF_SIZE; }
+
+    void split(const float *x, const float *y, size_t lo, size_t hi)
+    {
+        if (isLeaf(lo, hi))
+            return;
+
+        float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+        for (size_t s = lo; s < hi; s++)
+        {
+            x0 = fminf(x0, x[ids[s]]);
+            x1 = fmaxf(x1, x[ids[s]]);
+            y0 = fminf(y0, y[ids[s]]);
+            y1 = fmaxf(y1, y[ids[s]]);
+        }
+
+        size_t mid = (lo + hi) / 2;
+        const float *key = x1 - x0 >= y1 - y0 ? x : y;
+        dims[mid] = key == y;
+        std::nth_element(ids.begin() + lo, ids.begin() + mid, ids.begin() + hi,
+                         [key](int a, int b)
+                         { return key[a] < key[b]; });
+        split(x, y, lo, mid);
+        split(x, y, mid + 1, hi);
+    }
+
+    // Recompute the boxes of [lo, hi) and return the sum of their areas
+    float refitRange(size_t lo, size_t hi)
+    {
+        if (lo >= hi)
+            return 0;
+
+        box2d_t b;
+        float area = 0;
+        size_t node;
+        if (isLeaf(lo, hi))
+        {
+            node = lo;
+            b.x0 = b.x1 = xs[lo];
+            b.y0 = b.y1 = ys[lo];
+            for (size_t s = lo + 1; s < hi; s++)
+                grow(b, xs[s], ys[s]);
+        }
+        else
+        {
+            node = (lo + hi) / 2;
+            area += refitRange(lo, node) + refitRange(node + 1, hi);
+            b.x0 = b.x1 = xs[node];
+            b.y0 = b.y1 = ys[node];
+            merge(b, boxes[isLeaf(lo, node) ? lo : (lo + node) / 2]);
+            if (node + 1 < hi)
+                merge(b, boxes[isLeaf(node + 1, hi) ? node + 1 : (node + 1 + hi) / 2]);
+        }
+        boxes[node] = b;
+        return area + (b.x1 - b.x0) * (b.y1 - b.y0);
+    }
+
+    static void grow(box2d_t &b, float x, float y)
+    {
+        b.x0 = fminf(b.x0, x);
+        b.x1 = fmaxf(b.x1, x);
+        b.y0 = fminf(b.y0, y);
+        b.y1 = fmaxf(b.y1, y);
+    }
+
+    static void merge(box2d_t &b, const box2d_t &o)
+    {
+        b.x0 = fminf(b.x0, o.x0);
+        b.x1 = fmaxf(b.x1, o.x1);
+        b.y0 = fminf(b.y0, o.y0);
+        b.y1 = fmaxf(b.y1, o.y1);
+    }
+
+    float dist2(size_t s, float x, float y) const
+    {
+        float dx = xs[s] - x, dy = ys[s] - y;
+        return dx * dx + dy * dy;
+    }
+
+    void searchKnn(size_t lo, size_t hi, float x, float y, float max_dist2, SpatialNearest &best) const
+    {
+        if (isLeaf(lo, hi))
+        {
+            if (box_dist2(boxes[lo], x, y) >= best.bound(max_dist2))
+                return;
+            for (size_t s = lo; s < hi; s++)
+            {
+                float d2 = dist2(s, x, y);
+                if (d2 < best.bound(max_dist2))
+                    best.add(ids[s], d2);
+            }
+            return;
+        }
+
+        size_t mid = (lo + hi) / 2;
+        if (box_dist2(boxes[mid], x, y) >= best.bound(max_dist2))
+            return;
+        float d2 = dist2(mid, x, y);
+        if (d2 < best.bound(max_dist2))
+            best.add(ids[mid], d2);
+
+        // Nearer side first so the bound shrinks early
+        bool right = dims[mid] ? y >= ys[mid] : x >= xs[mid];
+        if (right)
+        {
+            if (mid + 1 < hi)
+                searchKnn(mid + 1, hi, x, y, max_dist2, best);
+            searchKnn(lo, mid, x, y, max_dist2, best);
+        }
+        else
+        {
+            searchKnn(lo, mid, x, y, max_dist2, best);
+            if (mid + 1 < hi)
+                searchKnn(mid + 1, hi, x, y, max_dist2, best);
+        }
+    }
+
+    void searchRadius(size_t lo, size_t hi, float x, float y, float r2, std::vector<int> &out) const
+    {
+        size_t node = isLeaf(lo, hi) ? lo : (lo + hi) / 2;
+        if (box_dist2(boxes[node], x, y) > r2)
+            return;
+        if (isLeaf(lo, hi))
+        {
+            for (size_t s = lo; s < hi; s++)
+                if (dist2(s, x, y) <= r2)
+                    out.push_back(ids[s]);
+            return;
+        }
+        if (dist2(node, x, y) <= r2)
+            out.push_back(ids[node]);
+        searchRadius(lo, node, x, y, r2, out);
+        if (node + 1 < hi)
+            searchRadius(node + 1, hi, x, y, r2, out);
+    }
+};
+
+/**
+ * @brief A hashed uniform grid over 2D points.
+ *
+ */
+class GridIndex2D
+{
+public:
+    /**
+     * @brief Construct a new GridIndex2D object.
+     *
+     * @param cell_size The cell size; about the usual query radius works well.
+     */
+    GridIndex2D(float cell_size) : cell(cell_size), inv_cell(1.0f / cell_size), n(0), mask(0) {}
+
+    /**
+     * @brief Build the grid from x and y arrays.
+     *
+     * @param x The x coordinates.
+     * @param y The y coordinates.
+     * @param count The number of points; queries return indices into x and y.
+     */
+    void build(const float *x, const float *y, size_t count)
+    {
+        n = count;
+        size_t buckets = 16;
+        while (buckets < 2 * n)
+            buckets <<= 1;
+        mask = buckets - 1;
+
+        bucket_start.assign(buckets + 1, 0);
+        keys.resize(n);
+        xs.resize(n);
+        ys.resize(n);
+        ids.resize(n);
+        tmp_key.resize(n);
+
+        // Counting sort by bucket
+        for (size_t i = 0; i < n; i++)
+        {
+            tmp_key[i] = cellKey(cellOf(x[i]), cellOf(y[i]));
+            bucket_start[bucketOf(tmp_key[i]) + 1]++;
+        }
+        for (size_t b = 0; b < buckets; b++)
+            bucket_start[b + 1] += bucket_start[b];
+        fill.assign(bucket_start.begin(), bucket_start.end() - 1);
+        x0 = y0 = INFINITY;
+        x1 = y1 = -INFINITY;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t s = fill[bucketOf(tmp_key[i])]++;
+            keys[s] = tmp_key[i];
+            xs[s] = x[i];
+            ys[s] = y[i];
+            ids[s] = (int)i;
+            x0 = fminf(x0, x[i]);
+            x1 = fmaxf(x1, x[i]);
+            y0 = fminf(y0, y[i]);
+            y1 = fmaxf(y1, y[i]);
+        }
+    }
+
+    /**
+     * @brief Build the grid from points.
+     *
+     */
+    void build(const point2d_t *points, size_t count)
+    {
+        unpack(points, count);
+        build(tmp_x.data(), tmp_y.data(), count);
+    }
+
+    /**
+     * @brief Build the grid from poses, by position.
+     *
+     */
+    void build(const pose2d_t *poses, size_t count)
+    {
+        unpack(poses, count);
+        build(tmp_x.data(), tmp_y.data(), count);
+    }
+
+    /**
+     * @brief Find every point within a radius.
+     *
+     * @param x The query x.
+     * @param y The query y.
+     * @param radius The radius, inclusive.
+     * @param out The point indices, in no particular order; appended to.
+     * @return size_t The number of points found.
+     */
+    size_t radius(float x, float y, float radius, std::vector<int> &out) const
+    {
+        size_t before = out.size();
+        if (n == 0)
+            return 0;
+        float r2 = radius * radius;
+        int cx0 = cellOf(fmaxf(x - radius, x0)), cx1 = cellOf(fminf(x + radius, x1));
+        int cy0 = cellOf(fmaxf(y - radius, y0)), cy1 = cellOf(fminf(y + radius, y1));
+        for (int cy = cy0; cy <= cy1; cy++)
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                uint64_t key = cellKey(cx, cy);
+                uint32_t b = bucketOf(key);
+                for (uint32_t s = bucket_start[b]; s < bucket_start[b + 1]; s++)
+                {
+                    float dx = xs[s] - x, dy = ys[s] - y;
+                    if (keys[s] == key && dx * dx + dy * dy <= r2)
+                        out.push_back(ids[s]);
+                }
+            }
+        return out.size() - before;
+    }
+
+    /**
+     * @brief Find the k nearest points, searching rings of cells outwards.
+     *
+     * @param x The query x.
+     * @param y The query y.
+     * @param k The number of points wanted.
+     * @param ids_out The point indices, nearest first, k ints.
+     * @param dist2 The squared distances, k floats.
+     * @param max_dist2 Only consider points closer than this squared distance.
+     * @return int The number of points found, at most k.
+     */
+    int knn(float x, float y, int k, int *ids_out, float *dist2, float max_dist2 = INFINITY) const
+    {
+        SpatialNearest best(k, ids_out, dist2);
+        if (n == 0 || k <= 0)
+            return 0;
+
+        int qx = cellOf(x), qy = cellOf(y);
+        int gx0 = cellOf(x0), gx1 = cellOf(x1), gy0 = cellOf(y0), gy1 = cellOf(y1);
+        // Rings that miss every occupied cell are skipped
+        int first = std::max(std::max(gx0 - qx, qx - gx1), std::max(gy0 - qy, qy - gy1));
+        int last = std::max(std::max(qx - gx0, gx1 - qx), std::max(qy - gy0, gy1 - qy));
+        for (int ring = std::max(first, 0); ring <= last; ring++)
+        {
+            // Every cell in this ring is at least (ring - 1) cells away
+            float near = (ring - 1) * cell;
+            if (near > 0 && near * near >= best.bound(max_dist2))
+                break;
+            for (int cy = std::max(qy - ring, gy0); cy <= std::min(qy + ring, gy1); cy++)
+            {
+                if (cy == qy - ring || cy == qy + ring)
+                {
+                    for (int cx = std::max(qx - ring, gx0); cx <= std::min(qx + ring, gx1); cx++)
+                        searchCell(cx, cy, x, y, max_dist2, best);
+                }
+                else
+                {
+                    if (qx - ring >= gx0)
+                        searchCell(qx - ring, cy, x, y, max_dist2, best);
+                    if (qx + ring <= gx1)
+                        searchCell(qx + ring, cy, x, y, max_dist2, best);
+                }
+            }
+        }
+        return best.count;
+    }
+
+    /**
+     * @brief Find the nearest point.
+     *
+     * @return int The point index, -1 if there is none.
+     */
+    int nearest(float x, float y, float max_dist2 = INFINITY, float *dist2 = NULL) const
+    {
+        int id = -1;
+        float d2 = max_dist2;
+        int found = knn(x, y, 1, &id, &d2, max_dist2);
+        if (dist2 != NULL)
+            *dist2 = d2;
+        return found > 0 ? id : -1;
+    }
+
+    /**
+     * @brief Return the number of points.
+     *
+     */
+    size_t size() const { return n; }
+
+private:
+    float cell, inv_cell;
+    size_t n;
+    uint32_t mask;
+    float x0, y0, x1, y1;
+
+    // Points sorted by bucket: bucket b holds slots [bucket_start[b], bucket_start[b + 1])
+    std::vector<uint32_t> bucket_start;
+    std::vector<uint64_t> keys;
+    std::vector<float> xs, ys;
+    std::vector<int> ids;
+    std::vector<uint64_t> tmp_key;
+    std::vector<uint32_t> fill;
+    std::vector<float> tmp_x, tmp_y;
+
+    template <class Point>
+    void unpack(const Point *points, size_t count)
+    {
+        tmp_x.resize(count);
+        tmp_y.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            tmp_x[i] = points[i].x;
+            tmp_y[i] = points[i].y;
+        }
+    }
+
+    int cellOf(float v) const { return (int)floorf(v * inv_cell); }
+
+    static uint64_t cellKey(int cx, int cy) { return (uint64_t)(uint32_t)cx << 32 | (uint32_t)cy; }
+
+    uint32_t bucketOf(uint64_t key) const { return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask; }
+
+    void searchCell(int cx, int cy, float x, float y, float max_dist2, SpatialNearest &best) const
+    {
+        uint64_t key = cellKey(cx, cy);
+        uint32_t b = bucketOf(key);
+        for (uint32_t s = bucket_start[b]; s < bucket_start[b + 1]; s++)
+        {
+            if (keys[s] != key)
+                continue;
+            float dx = xs[s] - x, dy = ys[s] - y;
+            float d2 = dx * dx + dy * dy;
+            if (d2 < best.bound(max_dist2))
+                best.add(ids[s], d2);
+        }
+    }
+};
+
+#endif // SPATIAL_INDEX_H
@@ -0,0 +1,172 @@
+/**
+ * @file spsc_queue.h
+ *
+ * @brief This file contains the SpscQueue class.
+ *
+ * A bounded lock-free ring for exactly one producer thread and one consumer
+ * thread. Each side keeps a cached copy of the other side's index, so the
+ * shared cache lines are only touched when the ring looks full or empty.
+ * Besides push()/pop() by copy, large elements can be written and read in
+ * place with claim()/publish() and front()/release().
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief A bounded single-producer single-consumer queue.
+ *
+ * @tparam T The element type.
+ */
+template <class T>
+class SpscQueue
+{
+public:
+    /**
+     * @brief Construct a new SpscQueue object.
+     *
+     * @param capacity The number of elements, rounded up to a power of two.
+     */
+    SpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        slots.reset(new T[size]);
+        write_pos.store(0, std::memory_order_relaxed);
+        read_pos.store(0, std::memory_order_relaxed);
+        read_cache = 0;
+        write_cache = 0;
+    }
+
+    /**
+     * @brief Return the slot to write next, from the producer, or NULL if the queue is full.
+     *
+     */
+    T *claim()
+    {
+        size_t w = write_pos.load(std::memory_order_relaxed);
+        if (w - read_cache > mask)
+        {
+            read_cache = read_pos.load(std::memory_order_acquire);
+            if (w - read_cache > mask)
+                return NULL;
+        }
+        return &slots[w & mask];
+    }
+
+    /**
+     * @brief Make the claimed slot visible to the consumer.
+     *
+     */
+    void publish()
+    {
+        write_pos.store(write_pos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Add an element by copy, from the producer.
+     *
+     * @return bool False if the queue is full.
+     */
+    bool push(const T &value)
+    {
+        T *slot = claim();
+        if (slot == NULL)
+            return false;
+        *slot = value;
+        publish();
+        return true;
+    }
+
+    /**
+     * @brief Return the oldest element, from the consumer, or NULL if the queue is empty.
+     *
+     */
+    T *front()
+    {
+        size_t r = read_pos.load(std::memory_order_relaxed);
+        if (r == write_cache)
+        {
+            write_cache = write_pos.load(std::memory_order_acquire);
+            if (r == write_cache)
+                return NULL;
+        }
+        return &slots[r & mask];
+    }
+
+    /**
+     * @brief Return the element n places after the oldest one, from the consumer, or NULL.
+     *
+     */
+    T *peek(size_t n)
+    {
+        size_t r = read_pos.load(std::memory_order_relaxed);
+        if (write_cache - r <= n)
+        {
+            write_cache = write_pos.load(std::memory_order_acquire);
+            if (write_cache - r <= n)
+                return NULL;
+        }
+        return &slots[(r + n) & mask];
+    }
+
+    /**
+     * @brief Hand the n oldest elements back to the producer.
+     *
+     */
+    void release(size_t n = 1)
+    {
+        read_pos.store(read_pos.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /**
+     * @brief Take the oldest element by copy, from the consumer.
+     *
+     * @return bool False if the queue is empty.
+     */
+    bool pop(T &value)
+    {
+        T *slot = front();
+        if (slot == NULL)
+            return false;
+        value = *slot;
+        release();
+        return true;
+    }
+
+    /**
+     * @brief Check if the queue is empty, from any thread.
+     *
+     */
+    bool empty() const
+    {
+        return read_pos.load(std::memory_order_acquire) == write_pos.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Return the capacity.
+     *
+     */
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::unique_ptr<T[]> slots;
+    size_t mask;
+
+    // Producer side
+    alignas(64) std::atomic<size_t> write_pos;
+    size_t read_cache;
+
+    // Consumer side
+    alignas(64) std::atomic<size_t> read_pos;
+    size_t write_cache;
+};
+
+#endif // SPSC_QUEUE_H
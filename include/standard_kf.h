@@ -3,16 +3,72 @@
  *
  * @author: Hayk Martirosyan
  * @date: 2014.11.15
+ *
+ * The filter is a template over the state size N and the measurement size M.
+ * With fixed sizes (e.g. KalmanFilter<4, 2>) every matrix lives inside the
+ * object and update() does not touch the heap (checked by
+ * tools/kf_alloc_check.cpp). The defaults (Eigen::Dynamic)
+ * keep the original MatrixXd behaviour, and with C++17 the template arguments
+ * are deduced from the constructor, so `KalmanFilter kf(dt, A, C, Q, R, P)`
+ * keeps working.
  */
 
+#ifndef STANDARD_KF_H
+#define STANDARD_KF_H
+
 #include <Eigen/Dense>
 #include <iostream>
 #include <stdexcept>
 
+/**
+ * Ways to fold a measurement into the estimate.
+ *   KF_UPDATE_INVERSE    - K = P C^T (C P C^T + R)^-1, P = (I - K C) P (the original path)
+ *   KF_UPDATE_LDLT       - K from an LDLT solve of the innovation system, P = P - K C P
+ *   KF_UPDATE_JOSEPH     - LDLT gain, P = (I - K C) P (I - K C)^T + K R K^T, keeps P
+ *                          symmetric positive definite when the gain is not optimal
+ *   KF_UPDATE_SEQUENTIAL - one scalar measurement at a time, no matrix solve at all;
+ *                          only valid when R is diagonal (off-diagonal terms are ignored)
+ */
+enum KalmanUpdateMethod
+{
+    KF_UPDATE_INVERSE,
+    KF_UPDATE_LDLT,
+    KF_UPDATE_JOSEPH,
+    KF_UPDATE_SEQUENTIAL
+};
+
+/**
+ * An extra sensor sharing a KalmanFilter with the one given at construction.
+ *   C - Output matrix of the sensor
+ *   R - Measurement noise covariance of the sensor
+ */
+template <int N, int MS>
+struct KalmanSensor
+{
+    Eigen::Matrix<double, MS, N> C;
+    Eigen::Matrix<double, MS, MS> R;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+template <int N = Eigen::Dynamic, int M = Eigen::Dynamic>
 class KalmanFilter
 {
 
 public:
+    typedef Eigen::Matrix<double, N, 1> StateVector;
+    typedef Eigen::Matrix<double, M, 1> MeasurementVector;
+    typedef Eigen::Matrix<double, N, N> StateMatrix;
+    typedef Eigen::Matrix<double, M, N> OutputMatrix;
+    typedef Eigen::Matrix<double, M, M> MeasurementMatrix;
+    typedef Eigen::Matrix<double, N, M> GainMatrix;
+
+    /**
+     * Fill the dynamics matrix A and the process noise Q in place
+     * for a time step of dt seconds.
+     */
+    typedef void (*TransitionFunction)(double dt, StateMatrix &A, StateMatrix &Q);
+
     /**
      * Create a Kalman filter with the specified matrices.
      *   A - System dynamics matrix
@@ -23,20 +79,33 @@ public:
      */
     KalmanFilter(
         double dt,
-        const Eigen::MatrixXd &A,
-        const Eigen::MatrixXd &C,
-        const Eigen::MatrixXd &Q,
-        const Eigen::MatrixXd &R,
-        const Eigen::MatrixXd &P)
-        : A(A), C(C), Q(Q), R(R), P0(P), m(C.rows()), n(A.rows()), dt(dt), initialized(false), I(n, n), x_hat(n), x_hat_new(n)
+        const StateMatrix &A,
+        const OutputMatrix &C,
+        const StateMatrix &Q,
+        const MeasurementMatrix &R,
+        const StateMatrix &P,
+        KalmanUpdateMethod method = KF_UPDATE_INVERSE)
+        : A(A), C(C), Q(Q), R(R), P0(P), m(C.rows()), n(A.rows()), dt(dt), initialized(false), method(method), transition(NULL)
     {
-        I.setIdentity();
+        I.setIdentity(n, n);
+        // zeroed rather than resized: a fixed-size filter is often copied before init()
+        this->P = P;
+        P_tmp.setZero(n, n);
+        x_hat.setZero(n);
+        x_hat_new.setZero(n);
+        t0 = t = 0;
     }
 
     /**
      * Create a blank estimator.
      */
-    KalmanFilter() {}
+    KalmanFilter() : initialized(false), method(KF_UPDATE_INVERSE), transition(NULL) {}
+
+    /**
+     * Select how measurements are folded into the estimate.
+     */
+    void setUpdateMethod(KalmanUpdateMethod method) { this->method = method; }
+    KalmanUpdateMethod updateMethod() const { return method; }
 
     /**
      * Initialize the filter with initial states as zero.
@@ -53,7 +122,7 @@ public:
     /**
      * Initialize the filter with a guess for initial states.
      */
-    void init(double t0, const Eigen::VectorXd &x0)
+    void init(double t0, const StateVector &x0)
     {
         x_hat = x0;
         P = P0;
@@ -65,18 +134,17 @@ public:
     /**
      * Update the estimated state based on measured values. The
      * time step is assumed to remain constant.
+     *
+     * With fixed N and M all temporaries are stack-sized, so this
+     * does not allocate.
      */
-    void update(const Eigen::VectorXd &y)
+    void update(const MeasurementVector &y)
     {
         if (!initialized)
             throw std::runtime_error("Filter is not initialized!");
 
-        x_hat_new = A * x_hat;
-        P = A * P * A.transpose() + Q;
-        K = P * C.transpose() * (C * P * C.transpose() + R).inverse();
-        x_hat_new += K * (y - C * x_hat_new);
-        P = (I - K * C) * P;
-        x_hat = x_hat_new;
+        propagate();
+        correctWith(y, C, R);
 
         t += dt;
     }
@@ -85,22 +153,179 @@ public:
      * Update the estimated state based on measured values,
      * using the given time step and dynamics matrix.
      */
-    void update(const Eigen::VectorXd &y, double dt, const Eigen::MatrixXd A)
+    void update(const MeasurementVector &y, double dt, const StateMatrix &A)
     {
         this->A = A;
         this->dt = dt;
         update(y);
     }
 
+    /**
+     * Set the function used by predict(t) to rebuild A and Q for the
+     * elapsed time. Without one, A and Q are used as given.
+     */
+    void setTransition(TransitionFunction transition) { this->transition = transition; }
+
+    /**
+     * Propagate the estimate to time t. Nothing happens when t is not
+     * ahead of the filter, so calling it for every sensor is cheap.
+     */
+    void predict(double t)
+    {
+        if (!initialized)
+            throw std::runtime_error("Filter is not initialized!");
+
+        if (t <= this->t)
+            return;
+
+        if (transition)
+            transition(t - this->t, A, Q);
+        propagate();
+        this->t = t;
+    }
+
+    /**
+     * Propagate the estimate to time t, with f(dt, A, Q) filling A and Q
+     * in place. Any callable works, so a lambda is inlined.
+     */
+    template <class Transition>
+    void predict(double t, Transition &&f)
+    {
+        if (!initialized)
+            throw std::runtime_error("Filter is not initialized!");
+
+        if (t <= this->t)
+            return;
+
+        f(t - this->t, A, Q);
+        propagate();
+        this->t = t;
+    }
+
+    /**
+     * Correct the estimate with a measurement taken at time t from the
+     * sensor given at construction. The filter is predicted to t first;
+     * a measurement older than the filter is applied at the current time.
+     */
+    void correct(const MeasurementVector &y, double t)
+    {
+        predict(t);
+        correctWith(y, C, R);
+    }
+
+    /**
+     * Correct the estimate with a measurement taken at time t from
+     * another sensor.
+     */
+    template <int MS>
+    void correct(const Eigen::Matrix<double, MS, 1> &y, double t, const KalmanSensor<N, MS> &sensor)
+    {
+        predict(t);
+        correctWith(y, sensor.C, sensor.R);
+    }
+
     /**
      * Return the current state and time.
      */
-    Eigen::VectorXd state() { return x_hat; };
+    StateVector state() { return x_hat; };
     double time() { return t; };
 
+    /**
+     * Return the current estimate error covariance.
+     */
+    const StateMatrix &covariance() const { return P; }
+
+    /**
+     * Overwrite the estimate with a previously saved snapshot.
+     */
+    void restore(double t, const StateVector &x, const StateMatrix &P)
+    {
+        x_hat = x;
+        this->P = P;
+        this->t = t;
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
 private:
+    /**
+     * x_hat = A x_hat, P = A P A^T + Q
+     */
+    void propagate()
+    {
+        x_hat_new.noalias() = A * x_hat;
+        x_hat = x_hat_new;
+        P_tmp.noalias() = A * P;
+        P.noalias() = P_tmp * A.transpose();
+        P += Q;
+    }
+
+    /**
+     * Fold the measurement y = C x + v, v ~ N(0, R), into x_hat and P.
+     * Templated on the measurement size so the temporaries stay fixed-size.
+     */
+    template <int MS>
+    void correctWith(
+        const Eigen::Matrix<double, MS, 1> &y,
+        const Eigen::Matrix<double, MS, N> &C,
+        const Eigen::Matrix<double, MS, MS> &R)
+    {
+        if (method == KF_UPDATE_SEQUENTIAL)
+        {
+            StateVector pc(n);
+            for (int j = 0; j < C.rows(); j++)
+            {
+                pc.noalias() = P * C.row(j).transpose();
+                double s = C.row(j).dot(pc) + R(j, j);
+                double innovation = y(j) - C.row(j).dot(x_hat);
+                x_hat += pc * (innovation / s);
+                P.noalias() -= pc * (pc.transpose() / s);
+            }
+            return;
+        }
+
+        Eigen::Matrix<double, N, MS> PCt;
+        Eigen::Matrix<double, MS, MS> S;
+        Eigen::Matrix<double, N, MS> K;
+
+        PCt.noalias() = P * C.transpose();
+        S.noalias() = C * PCt;
+        S += R;
+
+        if (method == KF_UPDATE_INVERSE)
+            K.noalias() = PCt * S.inverse();
+        else
+            K.noalias() = S.ldlt().solve(PCt.transpose()).transpose();
+
+        Eigen::Matrix<double, MS, 1> innovation = y;
+        innovation.noalias() -= C * x_hat;
+        x_hat.noalias() += K * innovation;
+
+        if (method == KF_UPDATE_INVERSE)
+        {
+            P_tmp.noalias() = (I - K * C) * P;
+            P = P_tmp;
+        }
+        else if (method == KF_UPDATE_JOSEPH)
+        {
+            StateMatrix IKC = I;
+            IKC.noalias() -= K * C;
+            P_tmp.noalias() = IKC * P;
+            P.noalias() = P_tmp * IKC.transpose();
+            P.noalias() += K * R * K.transpose();
+        }
+        else
+        {
+            P.noalias() -= K * PCt.transpose();
+        }
+    }
+
     // Matrices for computation
-    Eigen::MatrixXd A, C, Q, R, P, K, P0;
+    StateMatrix A;
+    OutputMatrix C;
+    StateMatrix Q;
+    MeasurementMatrix R;
+    StateMatrix P, P0, P_tmp;
 
     // System dimensions
     int m, n;
@@ -114,9 +339,17 @@ private:
     // Is the filter initialized?
     bool initialized;
 
+    // How measurements are folded in
+    KalmanUpdateMethod method;
+
+    // Rebuilds A and Q for predict(t), may be NULL
+    TransitionFunction transition;
+
     // n-size identity
-    Eigen::MatrixXd I;
+    StateMatrix I;
 
     // Estimated states
-    Eigen::VectorXd x_hat, x_hat_new;
+    StateVector x_hat, x_hat_new;
 };
+
+#endif // STANDARD_KF_H
@@ -0,0 +1,260 @@
+/**
+ * @file static_fsm.h
+ *
+ * @brief This file contains the table-driven StaticMachine.
+ *
+ * States, events, guards, actions and entry/exit hooks are declared once as
+ * constexpr arrays and compiled by make_fsm() into a transition table indexed
+ * by [state][event], so dispatch is a table lookup instead of a switch ladder,
+ * with no virtual calls and no heap. The timeout() and reentry() timers of
+ * MachineState become per-state timed transitions, checked by tick().
+ *
+ * @code{.cpp}
+ * enum { IDLE, RUN, FAULT, NUM_STATES };
+ * enum { EV_START, EV_STOP, EV_ERROR, NUM_EVENTS };
+ *
+ * struct Robot { int speed; };
+ * bool is_ready(Robot &r) { return r.speed == 0; }
+ * void stop_motors(Robot &r) { r.speed = 0; }
+ *
+ * constexpr FsmState<Robot> robot_states[] = {
+ *     // entry, exit, timeout, timeout target, reentry, reentry target
+ *     {NULL, NULL, 0, 0, 0, 0},                  // IDLE
+ *     {NULL, stop_motors, 0, 0, 0.1f, FAULT},    // RUN, FAULT if not ticked for 100 ms
+ *     {stop_motors, NULL, 2.0f, IDLE, 0, 0},     // FAULT, back to IDLE after 2 s
+ * };
+ * constexpr FsmTransition<Robot> robot_transitions[] = {
+ *     // from, event, to, guard, action
+ *     {IDLE, EV_START, RUN, is_ready, NULL},
+ *     {RUN, EV_STOP, IDLE, NULL, NULL},
+ *     {RUN, EV_ERROR, FAULT, NULL, NULL},
+ * };
+ * constexpr auto robot_fsm = make_fsm<NUM_EVENTS>(robot_states, robot_transitions);
+ *
+ * Robot robot = {0};
+ * StaticMachine<robot_fsm> machine(robot, IDLE);
+ * machine.dispatch(EV_START);
+ * machine.tick(); // once per cycle
+ * @endcode
+ */
+
+#ifndef STATIC_FSM_H
+#define STATIC_FSM_H
+
+#include "custom_time.h"
+#include "fsm_trace.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+
+/**
+ * @brief A transition, taken when event arrives in state from and guard (if any) passes.
+ *
+ */
+template <class Context>
+struct FsmTransition
+{
+    int16_t from;
+    int16_t event;
+    int16_t to;
+    bool (*guard)(Context &);
+    void (*action)(Context &);
+};
+
+/**
+ * @brief Per-state hooks and timed transitions.
+ *
+ * timeout: after this many seconds in the state, go to timeout_target (MachineState::timeout).
+ * reentry: if tick() was not called for this many seconds, go to reentry_target (MachineState::reentry).
+ * A period of 0 disables the timer.
+ */
+template <class Context>
+struct FsmState
+{
+    void (*entry)(Context &);
+    void (*exit)(Context &);
+    float timeout;
+    int16_t timeout_target;
+    float reentry;
+    int16_t reentry_target;
+};
+
+/**
+ * @brief A compiled state machine definition, built by make_fsm().
+ *
+ */
+template <class Context, int S, int E, int T>
+struct FsmDefinition
+{
+    typedef Context context_type;
+    static constexpr int num_states = S;
+    static constexpr int num_events = E;
+    static constexpr int num_transitions = T;
+
+    FsmState<Context> states[S];
+    FsmTransition<Context> transitions[T];
+
+    // First transition for [state][event] and the next one with the same pair, -1 for none
+    int16_t first[S][E];
+    int16_t next[T];
+
+    // Timers in nanoseconds, 0 for none
+    uint64_t timeout_ns[S];
+    uint64_t reentry_ns[S];
+};
+
+/**
+ * @brief Compile states and transitions into a dispatch table.
+ *
+ * Transitions sharing a (from, event) pair are tried in declaration order.
+ *
+ * @tparam E The number of events.
+ * @param states The states, indexed by state id.
+ * @param transitions The transitions.
+ * @return FsmDefinition The definition to instantiate StaticMachine with.
+ */
+template <int E, class Context, int S, int T>
+constexpr FsmDefinition<Context, S, E, T> make_fsm(const FsmState<Context> (&states)[S], const FsmTransition<Context> (&transitions)[T])
+{
+    FsmDefinition<Context, S, E, T> def{};
+
+    for (int s = 0; s < S; s++)
+    {
+        def.states[s] = states[s];
+        def.timeout_ns[s] = (uint64_t)(states[s].timeout * 1.0e9);
+        def.reentry_ns[s] = (uint64_t)(states[s].reentry * 1.0e9);
+        for (int e = 0; e < E; e++)
+            def.first[s][e] = -1;
+    }
+
+    for (int t = T - 1; t >= 0; t--)
+    {
+        def.transitions[t] = transitions[t];
+        def.next[t] = def.first[transitions[t].from][transitions[t].event];
+        def.first[transitions[t].from][transitions[t].event] = t;
+    }
+
+    return def;
+}
+
+/**
+ * @brief A state machine running a constexpr FsmDefinition.
+ *
+ * @tparam Def The definition, a constexpr object made by make_fsm().
+ * @tparam Clock The clock used by the timers, see custom_time.h.
+ */
+template <const auto &Def, class Clock = MonotonicClock>
+class StaticMachine
+{
+    typedef typename std::decay<decltype(Def)>::type definition_type;
+    typedef typename definition_type::context_type Context;
+
+public:
+    /**
+     * @brief Construct a new StaticMachine object. The initial state's entry hook is not run.
+     *
+     * @param context The object passed to guards, actions and hooks.
+     * @param initial The initial state.
+     */
+    StaticMachine(Context &context, int16_t initial = 0)
+        : context(context), value(initial), trace_id(0)
+    {
+        entered_ns = last_tick_ns = Clock::now_ns();
+    }
+
+    /**
+     * @brief Deliver an event.
+     *
+     * @param event The event.
+     * @return bool True if a transition was taken.
+     */
+    bool dispatch(int16_t event)
+    {
+        if ((uint16_t)event >= (uint16_t)definition_type::num_events)
+            return false;
+
+        for (int i = Def.first[value][event]; i >= 0; i = Def.next[i])
+        {
+            const FsmTransition<Context> &tr = Def.transitions[i];
+            if (tr.guard == NULL || tr.guard(context))
+            {
+                transit(tr.to, tr.action, event, Clock::now_ns());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Check the timed transitions of the current state. Call it once per cycle.
+     *
+     */
+    void tick()
+    {
+        uint64_t t_now = Clock::now_ns();
+        uint64_t since_tick = t_now - last_tick_ns;
+        last_tick_ns = t_now;
+
+        uint64_t reentry = Def.reentry_ns[value];
+        if (reentry && since_tick > reentry)
+        {
+            transit(Def.states[value].reentry_target, NULL, FSM_TRACE_REENTRY, t_now);
+            return;
+        }
+
+        uint64_t timeout = Def.timeout_ns[value];
+        if (timeout && t_now - entered_ns > timeout)
+            transit(Def.states[value].timeout_target, NULL, FSM_TRACE_TIMEOUT, t_now);
+    }
+
+    /**
+     * @brief Force a state, running the exit and entry hooks.
+     *
+     * @param target The new state.
+     */
+    void set(int16_t target)
+    {
+        transit(target, NULL, FSM_TRACE_SET, Clock::now_ns());
+    }
+
+    /**
+     * @brief Return the current state.
+     *
+     */
+    int16_t current() const { return value; }
+
+    /**
+     * @brief Return how long the machine has been in the current state, in nanoseconds.
+     *
+     */
+    uint64_t timeInState() const { return Clock::now_ns() - entered_ns; }
+
+    /**
+     * @brief Set the machine id recorded by FSM_TRACE, see fsm_trace.h.
+     *
+     */
+    void setTraceId(uint32_t id) { trace_id = id; }
+
+private:
+    void transit(int16_t target, void (*action)(Context &), int16_t cause, uint64_t t_now)
+    {
+        FSM_TRACE(trace_id, value, target, cause);
+        if (Def.states[value].exit)
+            Def.states[value].exit(context);
+        if (action)
+            action(context);
+        value = target;
+        entered_ns = t_now;
+        if (Def.states[value].entry)
+            Def.states[value].entry(context);
+    }
+
+    Context &context;
+    int16_t value;
+    uint64_t entered_ns;
+    uint64_t last_tick_ns;
+    uint32_t trace_id;
+};
+
+#endif // STATIC_FSM_H
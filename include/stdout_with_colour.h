@@ -19,52 +19,77 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
  * @brief Print text with colour.
+ * @brief The colour codes and the text are formatted into one buffer and printed with a single call,
+ * @brief so lines from different threads do not interleave. See async_log.h for logging from hot loops.
  *
  * @param color The colour of the text.
  * @param text The text to print.
  */
-void LogWithColor(__uint8_t color, const char *text, ...)
+inline void LogWithColor(__uint8_t color, const char *text, ...)
 {
-
+    const char *code;
     switch (color)
     {
     case COLOR_RED:
-        printf("\033[1;31m");
+        code = "\033[1;31m";
         break;
     case COLOR_GREEN:
-        printf("\033[1;32m");
+        code = "\033[1;32m";
         break;
     case COLOR_YELLOW:
-        printf("\033[1;33m");
+        code = "\033[1;33m";
         break;
     case COLOR_BLUE:
-        printf("\033[1;34m");
+        code = "\033[1;34m";
         break;
     case COLOR_MAGENTA:
-        printf("\033[1;35m");
+        code = "\033[1;35m";
         break;
     case COLOR_CYAN:
-        printf("\033[1;36m");
+        code = "\033[1;36m";
         break;
     case COLOR_WHITE:
-        printf("\033[1;37m");
-        break;
-    case COLOR_RESET:
-        printf("\033[0m");
+        code = "\033[1;37m";
         break;
     default:
-        printf("\033[0m");
+        code = "\033[0m";
         break;
     }
 
+    char stack[512];
+    char *buffer = stack;
+    size_t prefix = strlen(code);
+    memcpy(buffer, code, prefix);
+
     va_list args;
     va_start(args, text);
-    vprintf(text, args);
+    int length = vsnprintf(buffer + prefix, sizeof(stack) - prefix, text, args);
     va_end(args);
-    printf("\033[0m");
+    if (length < 0)
+        return;
+
+    // Too long for the stack buffer, format again on the heap
+    size_t total = prefix + length + 4;
+    if (total + 1 > sizeof(stack))
+    {
+        buffer = (char *)malloc(total + 1);
+        if (buffer == NULL)
+            return;
+        memcpy(buffer, code, prefix);
+        va_start(args, text);
+        vsnprintf(buffer + prefix, length + 1, text, args);
+        va_end(args);
+    }
+
+    memcpy(buffer + prefix + length, "\033[0m", 4);
+    fwrite(buffer, 1, total, stdout);
+    if (buffer != stack)
+        free(buffer);
 }
 
 #endif
\ No newline at end of file
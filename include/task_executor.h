@@ -0,0 +1,308 @@
+/**
+ * @file task_executor.h
+ *
+ * @brief This file contains the TaskExecutor and ParallelExecutor classes.
+ *
+ * TaskExecutor runs many periodic tasks (PID loops, MachineState ticks,
+ * Kalman filter updates) cooperatively on one thread. The tasks are kept in
+ * a min-heap ordered by their next deadline; the executor sleeps until the
+ * earliest one, runs every task that is due and accounts the time each one
+ * took. ParallelExecutor spreads tasks over several such executors, one per
+ * worker thread.
+ *
+ * @code{.cpp}
+ * TaskExecutor<> executor;
+ * executor.addTask("wheel_pid", 1000.0, [&] { out = pid.calculate(err, 100); });
+ * executor.addTask("fsm", 50.0, [&] { step(state); });
+ * executor.run(); // until executor.stop()
+ * @endcode
+ */
+
+#ifndef TASK_EXECUTOR_H
+#define TASK_EXECUTOR_H
+
+#include "custom_time.h"
+#include "rate_loop.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Execution accounting of one task.
+ *
+ */
+typedef struct
+{
+    uint64_t runs;               // completed runs
+    uint64_t missed;             // activations skipped because the task ran late
+    uint64_t total_exec_ns;      // time spent in the task
+    uint64_t max_exec_ns;        // longest run
+    uint64_t max_start_delay_ns; // latest start after the deadline
+} task_stats_t;
+
+/**
+ * @brief A single-threaded cooperative executor of periodic tasks.
+ *
+ * Tasks are added before run(); the task callables must not block.
+ *
+ * @tparam Clock The clock, see custom_time.h.
+ */
+template <class Clock = MonotonicClock>
+class TaskExecutor
+{
+public:
+    /**
+     * @brief Construct a new TaskExecutor object.
+     *
+     */
+    TaskExecutor() : stopped(false)
+    {
+    }
+
+    /**
+     * @brief Register a periodic task. Its first run is due immediately.
+     *
+     * @param name The task name, for reporting.
+     * @param rate_hz The task rate.
+     * @param fn The task body.
+     * @return int The task id.
+     */
+    int addTask(const char *name, double rate_hz, const std::function<void()> &fn)
+    {
+        Task task;
+        task.name = name;
+        task.period = (uint64_t)(1.0e9 / rate_hz);
+        task.next = Clock::now_ns();
+        task.fn = fn;
+        task.stat = task_stats_t();
+        tasks.push_back(task);
+
+        int id = (int)tasks.size() - 1;
+        heap.push_back(id);
+        std::push_heap(heap.begin(), heap.end(), Later(tasks));
+        return id;
+    }
+
+    /**
+     * @brief Run every task that is due.
+     *
+     * @return uint64_t The next deadline in nanoseconds, 0 if there are no tasks.
+     */
+    uint64_t spinOnce()
+    {
+        if (heap.empty())
+            return 0;
+
+        uint64_t t_now = Clock::now_ns();
+        while (tasks[heap.front()].next <= t_now)
+        {
+            std::pop_heap(heap.begin(), heap.end(), Later(tasks));
+            Task &task = tasks[heap.back()];
+
+            uint64_t delay = t_now - task.next;
+            task.fn();
+            uint64_t t_end = Clock::now_ns();
+
+            uint64_t exec = t_end - t_now;
+            task.stat.runs++;
+            task.stat.total_exec_ns += exec;
+            if (exec > task.stat.max_exec_ns)
+                task.stat.max_exec_ns = exec;
+            if (delay > task.stat.max_start_delay_ns)
+                task.stat.max_start_delay_ns = delay;
+
+            task.next += task.period;
+            if (task.next <= t_end)
+            {
+                uint64_t skip = (t_end - task.next) / task.period + 1;
+                task.stat.missed += skip;
+                task.next += skip * task.period;
+            }
+
+            std::push_heap(heap.begin(), heap.end(), Later(tasks));
+            t_now = t_end;
+        }
+        return tasks[heap.front()].next;
+    }
+
+    /**
+     * @brief Run the tasks until stop() is called, sleeping between deadlines.
+     *
+     */
+    void run()
+    {
+        while (!stopped.load(std::memory_order_relaxed))
+        {
+            uint64_t next = spinOnce();
+            if (next == 0)
+                break;
+            Clock::sleep_until_ns(next);
+        }
+    }
+
+    /**
+     * @brief Make run() return after the current round, callable from any thread.
+     * Also makes a later run() return immediately.
+     *
+     */
+    void stop()
+    {
+        stopped = true;
+    }
+
+    /**
+     * @brief Return the number of tasks.
+     *
+     */
+    int size() const { return (int)tasks.size(); }
+
+    /**
+     * @brief Return the name of a task.
+     *
+     */
+    const char *name(int id) const { return tasks[id].name.c_str(); }
+
+    /**
+     * @brief Return the accounting of a task.
+     *
+     */
+    const task_stats_t &stats(int id) const { return tasks[id].stat; }
+
+private:
+    struct Task
+    {
+        std::string name;
+        uint64_t period;
+        uint64_t next;
+        std::function<void()> fn;
+        task_stats_t stat;
+    };
+
+    // Heap order: earliest deadline on top, ties by id
+    struct Later
+    {
+        const std::vector<Task> &tasks;
+        Later(const std::vector<Task> &tasks) : tasks(tasks) {}
+        bool operator()(int a, int b) const
+        {
+            if (tasks[a].next != tasks[b].next)
+                return tasks[a].next > tasks[b].next;
+            return a > b;
+        }
+    };
+
+    std::vector<Task> tasks;
+    std::vector<int> heap;
+    std::atomic<bool> stopped;
+};
+
+/**
+ * @brief Periodic tasks partitioned over several worker threads.
+ *
+ * Each task is assigned to the worker with the least estimated load (rate times
+ * cost) when it is added; every worker is a TaskExecutor on its own thread.
+ *
+ * @tparam Clock The clock, see custom_time.h.
+ */
+template <class Clock = MonotonicClock>
+class ParallelExecutor
+{
+public:
+    /**
+     * @brief Construct a new ParallelExecutor object.
+     *
+     * @param workers The number of worker threads.
+     * @param cpus Optional CPU per worker to pin it to.
+     * @param rt_priority SCHED_FIFO priority of the workers, 0 to keep the default policy.
+     */
+    ParallelExecutor(int workers, const int *cpus = NULL, int rt_priority = 0)
+        : load(workers, 0.0), rt_priority(rt_priority)
+    {
+        for (int i = 0; i < workers; i++)
+        {
+            executors.push_back(std::unique_ptr<TaskExecutor<Clock> >(new TaskExecutor<Clock>()));
+            cpu.push_back(cpus ? cpus[i] : -1);
+        }
+    }
+
+    ~ParallelExecutor()
+    {
+        stop();
+    }
+
+    /**
+     * @brief Register a periodic task on the least loaded worker.
+     *
+     * @param name The task name, for reporting.
+     * @param rate_hz The task rate.
+     * @param fn The task body.
+     * @param cost_ns The expected run time, used to balance the workers; 0 counts every run the same.
+     * @return int The worker the task was given to.
+     */
+    int addTask(const char *name, double rate_hz, const std::function<void()> &fn, uint64_t cost_ns = 0)
+    {
+        int worker = (int)(std::min_element(load.begin(), load.end()) - load.begin());
+        load[worker] += rate_hz * (cost_ns ? (double)cost_ns : 1.0);
+        executors[worker]->addTask(name, rate_hz, fn);
+        return worker;
+    }
+
+    /**
+     * @brief Start the worker threads.
+     *
+     */
+    void start()
+    {
+        for (size_t i = 0; i < executors.size(); i++)
+            threads.push_back(std::thread(&ParallelExecutor::work, executors[i].get(), cpu[i], rt_priority));
+    }
+
+    /**
+     * @brief Stop and join the worker threads.
+     *
+     */
+    void stop()
+    {
+        for (size_t i = 0; i < executors.size(); i++)
+            executors[i]->stop();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+        threads.clear();
+    }
+
+    /**
+     * @brief Return the executor of one worker, e.g. for its task statistics.
+     *
+     */
+    TaskExecutor<Clock> &worker(int i) { return *executors[i]; }
+
+    /**
+     * @brief Return the number of workers.
+     *
+     */
+    int size() const { return (int)executors.size(); }
+
+private:
+    static void work(TaskExecutor<Clock> *executor, int pin, int priority)
+    {
+        if (pin >= 0)
+            pin_thread_to_cpu(pin);
+        if (priority > 0)
+            set_thread_realtime(priority);
+        executor->run();
+    }
+
+    std::vector<std::unique_ptr<TaskExecutor<Clock> > > executors;
+    std::vector<double> load;
+    std::vector<int> cpu;
+    std::vector<std::thread> threads;
+    int rt_priority;
+};
+
+#endif // TASK_EXECUTOR_H
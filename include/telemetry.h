@@ -0,0 +1,778 @@
+/**
+ * @file telemetry.h
+ *
+ * @brief This file contains the TelemetryLog recorder and the TelemetryReader.
+ *
+ * A telemetry log is a memory-mapped, append-only binary file. Its header
+ * describes every stream (a named record type) and its fields, so the file
+ * can be read without the code that wrote it. Writers reserve space with a
+ * single fetch_add on the end offset, fill the payload directly in the
+ * mapping and commit by publishing the record's size word, so recording is
+ * wait-free and never copies or calls the kernel. A record that was reserved
+ * but never committed ends the readable part of the log.
+ *
+ * File layout: telemetry_file_t, then per stream a telemetry_stream_t and its
+ * telemetry_field_t, then records, each a telemetry_record_t followed by the
+ * payload, padded to 8 bytes.
+ *
+ * @code{.cpp}
+ * TelemetryLog log;
+ * int pid_stream = telemetry_add_pid(log, "steer_pid");
+ * int kf_stream = telemetry_add_kalman(log, "pose_kf", 4);
+ * log.open("run.tlm", 64 << 20);
+ *
+ * // In the loop
+ * uint64_t t = MonotonicClock::now_ns();
+ * telemetry_publish_pid(log, pid_stream, t, pid);
+ * telemetry_publish_kalman(log, kf_stream, t, kf);
+ *
+ * // Offline, or with tools/telemetry_convert
+ * telemetry_to_csv("run.tlm", "csv_dir");
+ * @endcode
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Field types.
+ *
+ */
+enum TelemetryType
+{
+    TELEMETRY_U8,
+    TELEMETRY_I8,
+    TELEMETRY_U16,
+    TELEMETRY_I16,
+    TELEMETRY_U32,
+    TELEMETRY_I32,
+    TELEMETRY_U64,
+    TELEMETRY_I64,
+    TELEMETRY_F32,
+    TELEMETRY_F64
+};
+
+/**
+ * @brief Return the size of a field type in bytes.
+ *
+ */
+inline size_t telemetry_type_size(uint8_t type)
+{
+    static const uint8_t sizes[] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+    return type <= TELEMETRY_F64 ? sizes[type] : 0;
+}
+
+/**
+ * @brief The file header.
+ *
+ */
+typedef struct
+{
+    char magic[8]; // "RDTELEM1"
+    uint32_t version;
+    uint32_t data_offset; // first record
+    uint64_t capacity;    // file size
+    uint64_t end;         // end of the records, written by close(), 0 if the writer did not close
+    uint32_t num_streams;
+    uint32_t reserved;
+} telemetry_file_t;
+
+/**
+ * @brief A stream descriptor, followed by num_fields telemetry_field_t.
+ *
+ */
+typedef struct
+{
+    char name[32];
+    uint16_t id;
+    uint16_t num_fields;
+    uint32_t payload_size;
+} telemetry_stream_t;
+
+/**
+ * @brief A field descriptor.
+ *
+ */
+typedef struct
+{
+    char name[32];
+    uint8_t type; // TelemetryType
+    uint8_t reserved;
+    uint16_t offset; // in the payload
+    uint32_t reserved2;
+} telemetry_field_t;
+
+/**
+ * @brief The header of every record. size is 0 until the record is committed.
+ *
+ */
+typedef struct
+{
+    uint32_t size; // header, payload and padding
+    uint16_t stream;
+    uint16_t reserved;
+    uint64_t t_ns;
+} telemetry_record_t;
+
+/**
+ * @brief An append-only telemetry recorder. Streams are added before open(); publishing is thread-safe.
+ *
+ */
+class TelemetryLog
+{
+public:
+    TelemetryLog() : base(NULL), capacity(0), fd(-1), tail(0), dropped_records(0) {}
+
+    ~TelemetryLog()
+    {
+        close();
+    }
+
+    TelemetryLog(const TelemetryLog &) = delete;
+    TelemetryLog &operator=(const TelemetryLog &) = delete;
+
+    /**
+     * @brief Describe a stream. Fields are laid out in order with natural alignment.
+     *
+     * @param name The stream name, at most 31 characters.
+     * @param names The field names, at most 31 characters each.
+     * @param types The field types.
+     * @param n The number of fields.
+     * @return int The stream id, -1 if the log is already open or a type is unknown.
+     */
+    int addStream(const char *name, const char *const *names, const uint8_t *types, int n)
+    {
+        if (base)
+            return -1;
+        for (int i = 0; i < n; i++)
+            if (telemetry_type_size(types[i]) == 0)
+                return -1;
+
+        Stream s;
+        memset(&s.desc, 0, sizeof(s.desc));
+        strncpy(s.desc.name, name, sizeof(s.desc.name) - 1);
+        s.desc.id = streams.size();
+        s.desc.num_fields = n;
+
+        size_t offset = 0;
+        for (int i = 0; i < n; i++)
+        {
+            telemetry_field_t f;
+            memset(&f, 0, sizeof(f));
+            strncpy(f.name, names[i], sizeof(f.name) - 1);
+            f.type = types[i];
+            size_t size = telemetry_type_size(types[i]);
+            offset = (offset + size - 1) / size * size;
+            f.offset = offset;
+            offset += size;
+            s.fields.push_back(f);
+        }
+        s.desc.payload_size = offset;
+        s.record_size = (sizeof(telemetry_record_t) + offset + 7) & ~(size_t)7;
+        streams.push_back(s);
+        return s.desc.id;
+    }
+
+    /**
+     * @brief Create the file, write the header and map it, touching every page up front.
+     *
+     * @param path The file path, truncated if it exists.
+     * @param capacity_bytes The file size; records that do not fit are dropped.
+     * @return bool False on error.
+     */
+    bool open(const char *path, size_t capacity_bytes)
+    {
+        close();
+
+        size_t header_size = sizeof(telemetry_file_t);
+        for (size_t i = 0; i < streams.size(); i++)
+            header_size += sizeof(telemetry_stream_t) + streams[i].fields.size() * sizeof(telemetry_field_t);
+        header_size = (header_size + 63) & ~(size_t)63;
+        if (capacity_bytes < header_size)
+            return false;
+
+        fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, capacity_bytes) != 0)
+        {
+            close();
+            return false;
+        }
+        void *map = mmap(NULL, capacity_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        base = (uint8_t *)map;
+        capacity = capacity_bytes;
+
+        telemetry_file_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "RDTELEM1", 8);
+        header.version = 1;
+        header.data_offset = header_size;
+        header.capacity = capacity_bytes;
+        header.num_streams = streams.size();
+        memcpy(base, &header, sizeof(header));
+
+        uint8_t *p = base + sizeof(header);
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            memcpy(p, &streams[i].desc, sizeof(telemetry_stream_t));
+            p += sizeof(telemetry_stream_t);
+            memcpy(p, streams[i].fields.data(), streams[i].fields.size() * sizeof(telemetry_field_t));
+            p += streams[i].fields.size() * sizeof(telemetry_field_t);
+        }
+
+        tail.store(header_size, std::memory_order_relaxed);
+        dropped_records.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Record the end offset in the header, flush and unmap.
+     *
+     */
+    void close()
+    {
+        if (base)
+        {
+            uint64_t end = std::min((uint64_t)tail.load(), (uint64_t)capacity);
+            memcpy(base + offsetof(telemetry_file_t, end), &end, sizeof(end));
+            msync(base, capacity, MS_ASYNC);
+            munmap(base, capacity);
+            base = NULL;
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    /**
+     * @brief Reserve a record and return its payload to fill in place, wait-free.
+     *
+     * @param stream The stream id.
+     * @param t_ns The record timestamp.
+     * @return void* The payload, of the stream's payload size, or NULL if the log is full or closed.
+     */
+    void *reserve(int stream, uint64_t t_ns)
+    {
+        if (base == NULL || (unsigned)stream >= streams.size())
+            return NULL;
+
+        size_t size = streams[stream].record_size;
+        size_t offset = tail.fetch_add(size, std::memory_order_relaxed);
+        if (offset + size > capacity)
+        {
+            dropped_records.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+
+        telemetry_record_t *r = (telemetry_record_t *)(base + offset);
+        r->stream = stream;
+        r->reserved = 0;
+        r->t_ns = t_ns;
+        return r + 1;
+    }
+
+    /**
+     * @brief Publish a reserved record to readers.
+     *
+     * @param payload The pointer returned by reserve().
+     */
+    void commit(void *payload)
+    {
+        telemetry_record_t *r = (telemetry_record_t *)payload - 1;
+        __atomic_store_n(&r->size, (uint32_t)streams[r->stream].record_size, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief Reserve, copy and commit a record.
+     *
+     * @param stream The stream id.
+     * @param t_ns The record timestamp.
+     * @param payload The payload, laid out as described by the stream.
+     * @return bool False if the record was dropped.
+     */
+    bool write(int stream, uint64_t t_ns, const void *payload)
+    {
+        void *p = reserve(stream, t_ns);
+        if (p == NULL)
+            return false;
+        memcpy(p, payload, streams[stream].desc.payload_size);
+        commit(p);
+        return true;
+    }
+
+    /**
+     * @brief Return the payload size of a stream in bytes, 0 for an unknown stream.
+     *
+     */
+    size_t payloadSize(int stream) const
+    {
+        return (unsigned)stream < streams.size() ? streams[stream].desc.payload_size : 0;
+    }
+
+    /**
+     * @brief Return the payload offset of a field, for filling reserved records.
+     *
+     */
+    size_t fieldOffset(int stream, int field) const { return streams[stream].fields[field].offset; }
+
+    /**
+     * @brief Return the number of bytes used, including the header.
+     *
+     */
+    size_t used() const { return std::min((size_t)tail.load(std::memory_order_relaxed), capacity); }
+
+    /**
+     * @brief Return the number of records dropped because the log was full.
+     *
+     */
+    uint64_t dropped() const { return dropped_records.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Check if the log is open.
+     *
+     */
+    bool isOpen() const { return base != NULL; }
+
+private:
+    struct Stream
+    {
+        telemetry_stream_t desc;
+        std::vector<telemetry_field_t> fields;
+        size_t record_size;
+    };
+
+    std::vector<Stream> streams;
+    uint8_t *base;
+    size_t capacity;
+    int fd;
+    alignas(64) std::atomic<size_t> tail;
+    std::atomic<uint64_t> dropped_records;
+};
+
+/**
+ * @brief A reader mapping a telemetry log, usable while it is still being written.
+ *
+ */
+class TelemetryReader
+{
+public:
+    /**
+     * @brief A view of one stream's descriptor and fields.
+     *
+     */
+    struct Stream
+    {
+        const telemetry_stream_t *desc;
+        const telemetry_field_t *fields;
+    };
+
+    TelemetryReader() : base(NULL), size(0), header(NULL) {}
+
+    ~TelemetryReader()
+    {
+        close();
+    }
+
+    TelemetryReader(const TelemetryReader &) = delete;
+    TelemetryReader &operator=(const TelemetryReader &) = delete;
+
+    /**
+     * @brief Map a log and parse its header.
+     *
+     * @param path The file path.
+     * @return bool False if the file is missing or not a telemetry log.
+     */
+    bool open(const char *path)
+    {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(telemetry_file_t))
+        {
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return false;
+        base = (const uint8_t *)map;
+        size = st.st_size;
+
+        header = (const telemetry_file_t *)base;
+        if (memcmp(header->magic, "RDTELEM1", 8) != 0 || header->version != 1 || header->data_offset > size)
+        {
+            close();
+            return false;
+        }
+
+        const uint8_t *p = base + sizeof(telemetry_file_t);
+        for (uint32_t i = 0; i < header->num_streams; i++)
+        {
+            Stream s;
+            s.desc = (const telemetry_stream_t *)p;
+            s.fields = (const telemetry_field_t *)(p + sizeof(telemetry_stream_t));
+            p += sizeof(telemetry_stream_t) + s.desc->num_fields * sizeof(telemetry_field_t);
+            if (p > base + header->data_offset)
+            {
+                close();
+                return false;
+            }
+            streams.push_back(s);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Unmap the log.
+     *
+     */
+    void close()
+    {
+        if (base)
+            munmap((void *)base, size);
+        base = NULL;
+        header = NULL;
+        size = 0;
+        streams.clear();
+    }
+
+    /**
+     * @brief Return the offset of the first record, the start of an iteration with next().
+     *
+     */
+    size_t begin() const { return header ? header->data_offset : 0; }
+
+    /**
+     * @brief Read the record at offset and advance offset past it.
+     *
+     * @param offset The iteration position, start at begin().
+     * @param record The record header.
+     * @param payload The record payload.
+     * @return bool False at the end of the committed records.
+     */
+    bool next(size_t &offset, const telemetry_record_t *&record, const uint8_t *&payload) const
+    {
+        if (base == NULL || offset + sizeof(telemetry_record_t) > size)
+            return false;
+        const telemetry_record_t *r = (const telemetry_record_t *)(base + offset);
+        uint32_t record_size = __atomic_load_n(&r->size, __ATOMIC_ACQUIRE);
+        if (record_size < sizeof(telemetry_record_t) || offset + record_size > size || r->stream >= streams.size())
+            return false;
+        record = r;
+        payload = (const uint8_t *)(r + 1);
+        offset += record_size;
+        return true;
+    }
+
+    /**
+     * @brief Read one field of a payload as a double.
+     *
+     */
+    static double field(const telemetry_field_t &f, const uint8_t *payload)
+    {
+        const uint8_t *p = payload + f.offset;
+        switch (f.type)
+        {
+        case TELEMETRY_U8:
+            return *p;
+        case TELEMETRY_I8:
+            return (int8_t)*p;
+        case TELEMETRY_U16:
+            return load<uint16_t>(p);
+        case TELEMETRY_I16:
+            return load<int16_t>(p);
+        case TELEMETRY_U32:
+            return load<uint32_t>(p);
+        case TELEMETRY_I32:
+            return load<int32_t>(p);
+        case TELEMETRY_U64:
+            return (double)load<uint64_t>(p);
+        case TELEMETRY_I64:
+            return (double)load<int64_t>(p);
+        case TELEMETRY_F32:
+            return load<float>(p);
+        case TELEMETRY_F64:
+            return load<double>(p);
+        default:
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Find a stream by name.
+     *
+     * @return int The stream id, -1 if there is none.
+     */
+    int findStream(const char *name) const
+    {
+        for (size_t i = 0; i < streams.size(); i++)
+            if (strncmp(streams[i].desc->name, name, sizeof(streams[i].desc->name)) == 0)
+                return i;
+        return -1;
+    }
+
+    /**
+     * @brief Return the streams, indexed by id.
+     *
+     */
+    const std::vector<Stream> &getStreams() const { return streams; }
+
+private:
+    template <class T>
+    static T load(const uint8_t *p)
+    {
+        T value;
+        memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+    const uint8_t *base;
+    size_t size;
+    const telemetry_file_t *header;
+    std::vector<Stream> streams;
+};
+
+/**
+ * @brief Write one CSV per stream, <dir>/<stream>.csv, with a t_ns column and one column per field.
+ *
+ * @param log_path The telemetry log.
+ * @param dir An existing directory.
+ * @return long The number of records converted, -1 on error.
+ */
+inline long telemetry_to_csv(const char *log_path, const char *dir)
+{
+    TelemetryReader reader;
+    if (!reader.open(log_path))
+        return -1;
+
+    const std::vector<TelemetryReader::Stream> &streams = reader.getStreams();
+    std::vector<FILE *> files(streams.size(), (FILE *)NULL);
+    bool ok = true;
+    for (size_t i = 0; i < streams.size() && ok; i++)
+    {
+        std::string path = std::string(dir) + "/" + streams[i].desc->name + ".csv";
+        files[i] = fopen(path.c_str(), "w");
+        ok = files[i] != NULL;
+        if (ok)
+        {
+            fprintf(files[i], "t_ns");
+            for (int f = 0; f < streams[i].desc->num_fields; f++)
+                fprintf(files[i], ",%s", streams[i].fields[f].name);
+            fprintf(files[i], "\n");
+        }
+    }
+
+    long n = 0;
+    size_t offset = reader.begin();
+    const telemetry_record_t *r;
+    const uint8_t *payload;
+    while (ok && reader.next(offset, r, payload))
+    {
+        const TelemetryReader::Stream &s = streams[r->stream];
+        FILE *f = files[r->stream];
+        fprintf(f, "%llu", (unsigned long long)r->t_ns);
+        for (int k = 0; k < s.desc->num_fields; k++)
+            fprintf(f, ",%.9g", TelemetryReader::field(s.fields[k], payload));
+        fprintf(f, "\n");
+        n++;
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+        if (files[i] && fclose(files[i]) != 0)
+            ok = false;
+    return ok ? n : -1;
+}
+
+/**
+ * @brief Write every field of every stream as a raw little-endian column, for numpy.fromfile and the like.
+ *
+ * Produces <dir>/<stream>.t_ns.u64 and <dir>/<stream>.<field>.<type> per field
+ * (type u8 .. f64), all with one value per record of the stream.
+ *
+ * @param log_path The telemetry log.
+ * @param dir An existing directory.
+ * @return long The number of records converted, -1 on error.
+ */
+inline long telemetry_to_columns(const char *log_path, const char *dir)
+{
+    static const char *suffixes[] = {"u8", "i8", "u16", "i16", "u32", "i32", "u64", "i64", "f32", "f64"};
+
+    TelemetryReader reader;
+    if (!reader.open(log_path))
+        return -1;
+
+    // One file per column, time first
+    const std::vector<TelemetryReader::Stream> &streams = reader.getStreams();
+    std::vector<std::vector<FILE *>> files(streams.size());
+    bool ok = true;
+    for (size_t i = 0; i < streams.size() && ok; i++)
+    {
+        std::string prefix = std::string(dir) + "/" + streams[i].desc->name + ".";
+        files[i].push_back(fopen((prefix + "t_ns.u64").c_str(), "wb"));
+        for (int f = 0; f < streams[i].desc->num_fields; f++)
+        {
+            uint8_t type = std::min(streams[i].fields[f].type, (uint8_t)TELEMETRY_F64);
+            files[i].push_back(fopen((prefix + streams[i].fields[f].name + "." + suffixes[type]).c_str(), "wb"));
+        }
+        for (size_t k = 0; k < files[i].size(); k++)
+            ok = ok && files[i][k] != NULL;
+    }
+
+    long n = 0;
+    size_t offset = reader.begin();
+    const telemetry_record_t *r;
+    const uint8_t *payload;
+    while (ok && reader.next(offset, r, payload))
+    {
+        const TelemetryReader::Stream &s = streams[r->stream];
+        std::vector<FILE *> &out = files[r->stream];
+        fwrite(&r->t_ns, sizeof(r->t_ns), 1, out[0]);
+        for (int k = 0; k < s.desc->num_fields; k++)
+            fwrite(payload + s.fields[k].offset, telemetry_type_size(s.fields[k].type), 1, out[k + 1]);
+        n++;
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+        for (size_t k = 0; k < files[i].size(); k++)
+            if (files[i][k] && fclose(files[i][k]) != 0)
+                ok = false;
+    return ok ? n : -1;
+}
+
+/**
+ * @brief Add a stream for PID, PIDController or PIDBank-like getters: proportional, integral, derivative, output.
+ *
+ * @return int The stream id.
+ */
+inline int telemetry_add_pid(TelemetryLog &log, const char *name)
+{
+    static const char *names[] = {"proportional", "integral", "derivative", "output"};
+    static const uint8_t types[] = {TELEMETRY_F32, TELEMETRY_F32, TELEMETRY_F32, TELEMETRY_F32};
+    return log.addStream(name, names, types, 4);
+}
+
+/**
+ * @brief Publish the terms of the last calculate() of a PID or PIDController.
+ *
+ * @return bool False if the record was dropped.
+ */
+template <class Pid>
+bool telemetry_publish_pid(TelemetryLog &log, int stream, uint64_t t_ns, const Pid &pid)
+{
+    if (log.payloadSize(stream) != 4 * sizeof(float))
+        return false;
+    float *p = (float *)log.reserve(stream, t_ns);
+    if (p == NULL)
+        return false;
+    p[0] = pid.getProportional();
+    p[1] = pid.getIntegral();
+    p[2] = pid.getDerivative();
+    p[3] = pid.getOutput();
+    log.commit(p);
+    return true;
+}
+
+/**
+ * @brief Add a stream for a Kalman filter: the filter time, then x0..x(n-1) and the covariance diagonal P0..P(n-1).
+ *
+ * @param n The state size.
+ * @return int The stream id.
+ */
+inline int telemetry_add_kalman(TelemetryLog &log, const char *name, int n)
+{
+    std::vector<std::string> labels;
+    labels.push_back("t");
+    for (int i = 0; i < n; i++)
+        labels.push_back("x" + std::to_string(i));
+    for (int i = 0; i < n; i++)
+        labels.push_back("P" + std::to_string(i));
+
+    std::vector<const char *> names;
+    for (size_t i = 0; i < labels.size(); i++)
+        names.push_back(labels[i].c_str());
+    std::vector<uint8_t> types(labels.size(), TELEMETRY_F64);
+    return log.addStream(name, names.data(), types.data(), names.size());
+}
+
+/**
+ * @brief Publish the time, state and covariance diagonal of a KalmanFilter (or anything with time(), state() and covariance()).
+ *
+ * @return bool False if the record was dropped or the stream was not added for this state size.
+ */
+template <class Filter>
+bool telemetry_publish_kalman(TelemetryLog &log, int stream, uint64_t t_ns, Filter &kf)
+{
+    const auto x = kf.state();
+    const int n = x.rows();
+    if (log.payloadSize(stream) != (1 + 2 * (size_t)n) * sizeof(double))
+        return false;
+    double *p = (double *)log.reserve(stream, t_ns);
+    if (p == NULL)
+        return false;
+    p[0] = kf.time();
+    for (int i = 0; i < n; i++)
+    {
+        p[1 + i] = x(i);
+        p[1 + n + i] = kf.covariance()(i, i);
+    }
+    log.commit(p);
+    return true;
+}
+
+/**
+ * @brief Add a stream for a MachineState: the state value and the interrupt counter.
+ *
+ * @return int The stream id.
+ */
+inline int telemetry_add_machine(TelemetryLog &log, const char *name)
+{
+    static const char *names[] = {"value", "intr_cntr"};
+    static const uint8_t types[] = {TELEMETRY_I16, TELEMETRY_U8};
+    return log.addStream(name, names, types, 2);
+}
+
+/**
+ * @brief Publish the state of a MachineState.
+ *
+ * @return bool False if the record was dropped.
+ */
+template <class Machine>
+bool telemetry_publish_machine(TelemetryLog &log, int stream, uint64_t t_ns, const Machine &machine)
+{
+    if (log.payloadSize(stream) != 3)
+        return false;
+    uint8_t *p = (uint8_t *)log.reserve(stream, t_ns);
+    if (p == NULL)
+        return false;
+    int16_t value = machine.value;
+    memcpy(p, &value, sizeof(value));
+    p[2] = machine.intr_cntr;
+    log.commit(p);
+    return true;
+}
+
+#endif // TELEMETRY_H
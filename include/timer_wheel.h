@@ -0,0 +1,173 @@
+/**
+ * @file timer_wheel.h
+ *
+ * @brief This file contains the TimerWheel class.
+ *
+ * A hashed timer wheel: time is cut into ticks of a fixed resolution and a
+ * timer with deadline tick d sits in slot d % slots, in an intrusive list.
+ * Scheduling and cancelling are O(1) and advancing only visits the slots of
+ * the ticks that passed, so thousands of timers cost nothing until they fire.
+ * The timer nodes belong to the caller and never allocate.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief A timer owned by the caller, linked into a TimerWheel while armed.
+ *
+ */
+struct TimerNode
+{
+    TimerNode *prev;
+    TimerNode *next;
+    uint64_t deadline_tick;
+    uint32_t generation; // bumped on every schedule/cancel, see TimerWheel::advance
+    uint32_t id;         // free for the caller
+    int32_t tag;         // free for the caller
+    bool armed;
+
+    TimerNode() : prev(NULL), next(NULL), deadline_tick(0), generation(0), id(0), tag(0), armed(false) {}
+};
+
+/**
+ * @brief A hashed timer wheel.
+ *
+ */
+class TimerWheel
+{
+public:
+    /**
+     * @brief Construct a new TimerWheel object.
+     *
+     * @param slots The number of slots, rounded up to a power of two.
+     * @param resolution_ns The tick length in nanoseconds.
+     * @param start_ns The current time in nanoseconds.
+     */
+    TimerWheel(uint32_t slots, uint64_t resolution_ns, uint64_t start_ns)
+        : resolution(resolution_ns), current(start_ns / resolution_ns)
+    {
+        uint32_t size = 2;
+        while (size < slots)
+            size <<= 1;
+        heads.assign(size, (TimerNode *)NULL);
+        mask = size - 1;
+    }
+
+    /**
+     * @brief Arm a timer, re-arming it if it is already armed.
+     *
+     * @param node The timer.
+     * @param deadline_ns The expiry time in nanoseconds; it fires on the first advance() at or after it.
+     */
+    void schedule(TimerNode *node, uint64_t deadline_ns)
+    {
+        cancel(node);
+        uint64_t tick = (deadline_ns + resolution - 1) / resolution;
+        if (tick <= current)
+            tick = current + 1;
+
+        node->deadline_tick = tick;
+        node->armed = true;
+        TimerNode *&head = heads[tick & mask];
+        node->prev = NULL;
+        node->next = head;
+        if (head)
+            head->prev = node;
+        head = node;
+    }
+
+    /**
+     * @brief Disarm a timer, a no-op if it is not armed.
+     *
+     * @param node The timer.
+     */
+    void cancel(TimerNode *node)
+    {
+        node->generation++;
+        if (!node->armed)
+            return;
+        unlink(node);
+    }
+
+    /**
+     * @brief Fire every timer due by now_ns.
+     *
+     * The due timers are collected first and fired afterwards, so fire may
+     * schedule or cancel any timer. A timer rescheduled or cancelled by an
+     * earlier callback of the same advance is not fired.
+     *
+     * @param now_ns The current time in nanoseconds.
+     * @param fire Called as fire(TimerNode *) for each expired timer.
+     */
+    template <class Fire>
+    void advance(uint64_t now_ns, Fire &&fire)
+    {
+        uint64_t now_tick = now_ns / resolution;
+        if (now_tick <= current)
+            return;
+
+        uint64_t steps = now_tick - current;
+        if (steps > mask + 1)
+            steps = mask + 1;
+
+        expired.clear();
+        for (uint64_t k = 1; k <= steps; k++)
+        {
+            TimerNode *node = heads[(current + k) & mask];
+            while (node)
+            {
+                TimerNode *next = node->next;
+                if (node->deadline_tick <= now_tick)
+                {
+                    unlink(node);
+                    expired.push_back(Expired(node, node->generation));
+                }
+                node = next;
+            }
+        }
+        current = now_tick;
+
+        for (size_t i = 0; i < expired.size(); i++)
+            if (expired[i].node->generation == expired[i].generation)
+                fire(expired[i].node);
+    }
+
+    /**
+     * @brief Return the tick length in nanoseconds.
+     *
+     */
+    uint64_t resolutionNs() const { return resolution; }
+
+private:
+    struct Expired
+    {
+        TimerNode *node;
+        uint32_t generation;
+        Expired(TimerNode *node, uint32_t generation) : node(node), generation(generation) {}
+    };
+
+    void unlink(TimerNode *node)
+    {
+        if (node->prev)
+            node->prev->next = node->next;
+        else
+            heads[node->deadline_tick & mask] = node->next;
+        if (node->next)
+            node->next->prev = node->prev;
+        node->prev = node->next = NULL;
+        node->armed = false;
+    }
+
+    std::vector<TimerNode *> heads;
+    uint64_t mask;
+    uint64_t resolution;
+    uint64_t current; // last tick processed
+    std::vector<Expired> expired;
+};
+
+#endif // TIMER_WHEEL_H
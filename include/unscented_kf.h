@@ -0,0 +1,324 @@
+/**
+ * @file unscented_kf.h
+ *
+ * @brief This file contains the UnscentedKalmanFilter class.
+ *
+ * The filter propagates 2N + 1 sigma points through user-supplied process and
+ * measurement functors, so no Jacobians are needed. The sigma-point weights
+ * are computed once at construction and the sigma points live in fixed-size
+ * buffers inside the object, so a step does not allocate.
+ *
+ * As in ExtendedKalmanFilter, the measurement functor may have a residual()
+ * member for angles, and here also a mean() member: sigma points on both
+ * sides of the +-pi cut average to about 0 instead of pi. If P stops being
+ * positive definite through rounding, it is symmetrised and a growing
+ * multiple of the identity is added until the Cholesky factorization works;
+ * a covariance that cannot be repaired, or is not finite, throws
+ * std::runtime_error.
+ *
+ * @code{.cpp}
+ * struct Process
+ * {
+ *     // x_next = f(x, dt)
+ *     void operator()(const Eigen::Vector4d &x, double dt, Eigen::Vector4d &x_next) const;
+ * };
+ *
+ * struct RangeBearing
+ * {
+ *     // z = h(x)
+ *     void operator()(const Eigen::Vector4d &x, Eigen::Vector2d &z) const;
+ *
+ *     // optional, v = y - z with the bearing wrapped, see extended_kf.h
+ *     void residual(const Eigen::Vector2d &y, const Eigen::Vector2d &z, Eigen::Vector2d &v) const;
+ *
+ *     // optional, the weighted mean of the sigma-point measurements, the bearing through its sin and cos
+ *     void mean(const Eigen::Matrix<double, 2, 9> &Z, const Eigen::Matrix<double, 9, 1> &W, Eigen::Vector2d &z) const
+ *     {
+ *         z(0) = Z.row(0).dot(W);
+ *         z(1) = std::atan2(Z.row(1).array().sin().matrix().dot(W), Z.row(1).array().cos().matrix().dot(W));
+ *     }
+ * };
+ *
+ * UnscentedKalmanFilter<4, 2, Process, RangeBearing> ukf(dt, Process(), RangeBearing(), Q, R, P);
+ * @endcode
+ */
+
+#ifndef UNSCENTED_KF_H
+#define UNSCENTED_KF_H
+
+#include "extended_kf.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Unscented Kalman filter over user-supplied models.
+ *
+ * @tparam N The state size.
+ * @tparam M The measurement size.
+ * @tparam Process The process model functor.
+ * @tparam Measurement The measurement model functor.
+ */
+template <int N, int M, class Process, class Measurement>
+class UnscentedKalmanFilter
+{
+    static_assert(N > 0 && M > 0, "UnscentedKalmanFilter needs fixed state and measurement sizes");
+
+public:
+    typedef typename KalmanFilter<N, M>::StateVector StateVector;
+    typedef typename KalmanFilter<N, M>::MeasurementVector MeasurementVector;
+    typedef typename KalmanFilter<N, M>::StateMatrix StateMatrix;
+    typedef typename KalmanFilter<N, M>::MeasurementMatrix MeasurementMatrix;
+    typedef typename KalmanFilter<N, M>::GainMatrix GainMatrix;
+
+    /**
+     * @brief The number of sigma points.
+     *
+     */
+    enum
+    {
+        SIGMA_POINTS = 2 * N + 1
+    };
+
+    /**
+     * @brief Construct a new UnscentedKalmanFilter object.
+     *
+     * @param dt The time step used by update(y).
+     * @param f The process model.
+     * @param h The measurement model.
+     * @param Q The process noise covariance.
+     * @param R The measurement noise covariance.
+     * @param P The initial estimate error covariance.
+     * @param alpha The sigma-point spread.
+     * @param beta The prior distribution knowledge, 2 is optimal for Gaussians.
+     * @param kappa The secondary scaling parameter.
+     */
+    UnscentedKalmanFilter(
+        double dt,
+        const Process &f,
+        const Measurement &h,
+        const StateMatrix &Q,
+        const MeasurementMatrix &R,
+        const StateMatrix &P,
+        double alpha = 1e-3,
+        double beta = 2.0,
+        double kappa = 0.0)
+        : f(f), h(h), Q(Q), R(R), P0(P), dt(dt), initialized(false)
+    {
+        double lambda = alpha * alpha * (N + kappa) - N;
+        gamma = std::sqrt(N + lambda);
+
+        Wm(0) = lambda / (N + lambda);
+        Wc(0) = Wm(0) + (1 - alpha * alpha + beta);
+        for (int i = 1; i < SIGMA_POINTS; i++)
+        {
+            Wm(i) = 1.0 / (2 * (N + lambda));
+            Wc(i) = Wm(i);
+        }
+    }
+
+    /**
+     * @brief Initialize the filter with initial states as zero.
+     *
+     */
+    void init()
+    {
+        x_hat.setZero();
+        P = P0;
+        t = 0;
+        initialized = true;
+    }
+
+    /**
+     * @brief Initialize the filter with a guess for initial states.
+     *
+     * @param t0 The initial time.
+     * @param x0 The initial state.
+     */
+    void init(double t0, const StateVector &x0)
+    {
+        x_hat = x0;
+        P = P0;
+        t = t0;
+        initialized = true;
+    }
+
+    /**
+     * @brief Predict by the constant time step and correct with y.
+     *
+     * @param y The measurement.
+     */
+    void update(const MeasurementVector &y)
+    {
+        if (!initialized)
+            throw std::runtime_error("Filter is not initialized!");
+
+        propagate(dt);
+        t += dt;
+        correctWith(y);
+    }
+
+    /**
+     * @brief Propagate the estimate to time t, a no-op if t is not ahead of the filter.
+     *
+     * @param t The target time.
+     */
+    void predict(double t)
+    {
+        if (!initialized)
+            throw std::runtime_error("Filter is not initialized!");
+
+        if (t <= this->t)
+            return;
+
+        propagate(t - this->t);
+        this->t = t;
+    }
+
+    /**
+     * @brief Correct the estimate with a measurement taken at time t.
+     *
+     * @param y The measurement.
+     * @param t The measurement time.
+     */
+    void correct(const MeasurementVector &y, double t)
+    {
+        predict(t);
+        correctWith(y);
+    }
+
+    /**
+     * @brief Return the current state, covariance and time.
+     *
+     */
+    StateVector state() { return x_hat; }
+    const StateMatrix &covariance() const { return P; }
+    double time() { return t; }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    /**
+     * Sigma points x, x +- gamma * sqrt(P) into X.
+     */
+    void generateSigmaPoints()
+    {
+        llt.compute(P);
+        // NaN passes the factorization, so check the factor too
+        if (llt.info() != Eigen::Success || !llt.matrixLLT().allFinite())
+            repairCovariance();
+        L = llt.matrixL();
+        X.col(0) = x_hat;
+        for (int i = 0; i < N; i++)
+        {
+            X.col(1 + i) = x_hat + gamma * L.col(i);
+            X.col(1 + N + i) = x_hat - gamma * L.col(i);
+        }
+    }
+
+    /**
+     * Symmetrise P and add jitter to its diagonal until it factorizes.
+     */
+    void repairCovariance()
+    {
+        if (!P.allFinite())
+            throw std::runtime_error("Covariance is not finite!");
+        L = P.transpose();
+        P = 0.5 * (P + L);
+        double jitter = 1e-9 * std::max(1.0, P.diagonal().cwiseAbs().maxCoeff());
+        for (int k = 0; k < 7; k++)
+        {
+            llt.compute(P);
+            if (llt.info() == Eigen::Success)
+                return;
+            P.diagonal().array() += jitter;
+            jitter *= 10;
+        }
+        llt.compute(P);
+        if (llt.info() != Eigen::Success)
+            throw std::runtime_error("Covariance is not positive definite!");
+    }
+
+    void propagate(double step)
+    {
+        generateSigmaPoints();
+        for (int i = 0; i < SIGMA_POINTS; i++)
+        {
+            x_tmp = X.col(i);
+            f(x_tmp, step, x_next);
+            X.col(i) = x_next;
+        }
+
+        x_hat.noalias() = X * Wm;
+        P = Q;
+        for (int i = 0; i < SIGMA_POINTS; i++)
+        {
+            x_tmp = X.col(i) - x_hat;
+            P.noalias() += Wc(i) * x_tmp * x_tmp.transpose();
+        }
+    }
+
+    void correctWith(const MeasurementVector &y)
+    {
+        generateSigmaPoints();
+        for (int i = 0; i < SIGMA_POINTS; i++)
+        {
+            x_tmp = X.col(i);
+            h(x_tmp, z_tmp);
+            Z.col(i) = z_tmp;
+        }
+
+        kf_measurement_mean(h, Z, Wm, z);
+        S = R;
+        Pxz.setZero();
+        for (int i = 0; i < SIGMA_POINTS; i++)
+        {
+            z_sigma = Z.col(i);
+            kf_measurement_residual(h, z_sigma, z, z_tmp);
+            x_tmp = X.col(i) - x_hat;
+            S.noalias() += Wc(i) * z_tmp * z_tmp.transpose();
+            Pxz.noalias() += Wc(i) * x_tmp * z_tmp.transpose();
+        }
+
+        K.noalias() = Pxz * S.inverse();
+        kf_measurement_residual(h, y, z, z_tmp);
+        x_hat.noalias() += K * z_tmp;
+        Pxz.noalias() = K * S;
+        P.noalias() -= Pxz * K.transpose();
+    }
+
+    // Models
+    Process f;
+    Measurement h;
+
+    // Noise and initial covariances
+    StateMatrix Q;
+    MeasurementMatrix R;
+    StateMatrix P0;
+
+    // Discrete time step and current time
+    double dt, t;
+
+    // Is the filter initialized?
+    bool initialized;
+
+    // Sigma-point scaling and weights
+    double gamma;
+    Eigen::Matrix<double, SIGMA_POINTS, 1> Wm, Wc;
+
+    // Estimate
+    StateVector x_hat;
+    StateMatrix P;
+
+    // Sigma points and workspace
+    Eigen::Matrix<double, N, SIGMA_POINTS> X;
+    Eigen::Matrix<double, M, SIGMA_POINTS> Z;
+    Eigen::LLT<StateMatrix> llt;
+    StateMatrix L;
+    StateVector x_tmp, x_next;
+    MeasurementVector z, z_tmp, z_sigma;
+    MeasurementMatrix S;
+    GainMatrix Pxz, K;
+};
+
+#endif // UNSCENTED_KF_H
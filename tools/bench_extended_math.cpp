@@ -0,0 +1,102 @@
+/**
+ * @file bench_extended_math.cpp
+ *
+ * @brief Time the batch geometry kernels at every SIMD level against the per-point loop.
+ *
+ * Random points on a 20 x 20 field. For each level the CPU supports, prints
+ * ns per point for distances, rectangle masks and triangle masks, and checks
+ * that the results are bit-identical to the scalar kernel (exit 1 if not).
+ * The last line times the existing one-point-at-a-time functions.
+ *
+ * g++ -std=c++17 -O2 -I../include bench_extended_math.cpp -o bench_extended_math
+ * ./bench_extended_math [points]
+ */
+
+#include "extended_math.h"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double ns_per_point(bench_clock::time_point a, bench_clock::time_point b, int reps, size_t n)
+{
+    return std::chrono::duration<double, std::nano>(b - a).count() / reps / n;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    const int reps = 100000000 / n + 1;
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> uniform(-10.0f, 10.0f);
+    std::vector<point2d_t> p(n);
+    std::vector<float> x(n), y(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        p[i].x = x[i] = uniform(gen);
+        p[i].y = y[i] = uniform(gen);
+    }
+
+    const char *names[] = {"scalar", "sse2", "avx2", "neon"};
+    std::vector<float> dist_ref, dist(n);
+    std::vector<uint8_t> rect_ref, tri_ref, rect(n), tri(n);
+    int failed = 0;
+    printf("%zu points, ns per point\n", n);
+    printf("%-8s %8s %8s %8s\n", "level", "dist", "rect", "tri");
+    for (int level = SIMD_SCALAR; level <= SIMD_NEON; level++)
+    {
+        if (!extended_math_set_simd(level))
+            continue;
+
+        size_t inside_rect = 0, inside_tri = 0;
+        auto t0 = bench_clock::now();
+        for (int r = 0; r < reps; r++)
+            pythagoras_batch(p.data(), n, point2d_t{1.0f, 2.0f}, dist.data());
+        auto t1 = bench_clock::now();
+        for (int r = 0; r < reps; r++)
+            inside_rect = is_inside_rectangle_batch(p.data(), n, 5.0f, -3.0f, 4.0f, -6.0f, rect.data());
+        auto t2 = bench_clock::now();
+        for (int r = 0; r < reps; r++)
+            inside_tri = check_point_is_inside_triangle_batch(x.data(), y.data(), n, -5.0f, -5.0f, 8.0f, 1.0f, 0.0f, 9.0f, tri.data());
+        auto t3 = bench_clock::now();
+
+        printf("%-8s %8.3f %8.3f %8.3f  (%zu, %zu inside)\n", names[level],
+               ns_per_point(t0, t1, reps, n), ns_per_point(t1, t2, reps, n), ns_per_point(t2, t3, reps, n),
+               inside_rect, inside_tri);
+
+        if (level == SIMD_SCALAR)
+        {
+            dist_ref = dist;
+            rect_ref = rect;
+            tri_ref = tri;
+        }
+        else if (dist != dist_ref || rect != rect_ref || tri != tri_ref)
+        {
+            printf("%s differs from scalar\n", names[level]);
+            failed = 1;
+        }
+    }
+
+    size_t count = 0;
+    float sum = 0.0f;
+    auto t0 = bench_clock::now();
+    for (int r = 0; r < reps; r++)
+        for (size_t i = 0; i < n; i++)
+        {
+            sum += pythagoras(p[i].x, p[i].y, 1.0f, 2.0f);
+            count += is_inside_rectangle(p[i], 5, -3, 4, -6);
+        }
+    auto t1 = bench_clock::now();
+    for (int r = 0; r < reps; r++)
+        for (size_t i = 0; i < n; i++)
+            count += check_point_is_inside_triangle(x[i], y[i], -5, -5, 8, 1, 0, 9);
+    auto t2 = bench_clock::now();
+    printf("old loop: dist+rect %.3f, tri %.3f  (%zu %g)\n",
+           ns_per_point(t0, t1, reps, n), ns_per_point(t1, t2, reps, n), count, sum);
+    return failed;
+}
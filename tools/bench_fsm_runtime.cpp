@@ -0,0 +1,123 @@
+/**
+ * @file bench_fsm_runtime.cpp
+ *
+ * @brief Time FsmRuntime ticks for many instances on one core.
+ *
+ * Runs on SimulatedClock with 1 ms ticks and measures three cases:
+ * - every instance gets one posted event per tick (post + dispatch);
+ * - a fifth of the instances time out and are re-armed per tick;
+ * - nothing happens (the cost of an idle tick).
+ *
+ * g++ -std=c++17 -O2 -I../include bench_fsm_runtime.cpp -o bench_fsm_runtime
+ * ./bench_fsm_runtime [instances]
+ */
+
+#include "fsm_runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum
+{
+    ON,
+    IDLE,
+    RUN,
+    OFF,
+    NUM_STATES
+};
+
+enum
+{
+    EV_GO,
+    EV_STOP,
+    EV_POWER,
+    EV_TIMEOUT,
+    NUM_EVENTS
+};
+
+struct Agent
+{
+    int runs;
+};
+
+static void count_run(Agent &a) { a.runs++; }
+
+static const HsmState<Agent> agent_states[] = {
+    {-1, IDLE, NULL, NULL, 0, -1},
+    {ON, -1, NULL, NULL, 0, -1},
+    {ON, -1, count_run, NULL, 0.005f, EV_TIMEOUT},
+    {-1, -1, NULL, NULL, 0, -1},
+};
+
+static const FsmTransition<Agent> agent_transitions[] = {
+    {IDLE, EV_GO, RUN, NULL, NULL},
+    {RUN, EV_STOP, IDLE, NULL, NULL},
+    {RUN, EV_TIMEOUT, IDLE, NULL, NULL},
+    {ON, EV_POWER, OFF, NULL, NULL},
+    {OFF, EV_POWER, ON, NULL, NULL},
+};
+
+static const HsmDefinition<Agent> agent_hsm(NUM_EVENTS, agent_states, agent_transitions);
+
+int main(int argc, char **argv)
+{
+    const int n = argc > 1 ? atoi(argv[1]) : 10000;
+    const int ticks = 200;
+    const uint64_t ms = 1000000;
+
+    FsmRuntime<Agent, SimulatedClock> runtime(agent_hsm, n, 1 << 16);
+    SimulatedClock::set_ns(0);
+    Agent agent = {0};
+    for (int i = 0; i < n; i++)
+        runtime.create(agent, ON);
+
+    uint64_t t = 0;
+    uint64_t t0 = MonotonicClock::now_ns();
+    for (int k = 0; k < ticks; k++)
+    {
+        t += ms;
+        for (int i = 0; i < n; i++)
+            runtime.post(i, (k & 1) ? EV_STOP : EV_GO);
+        runtime.tick(t);
+    }
+    uint64_t t1 = MonotonicClock::now_ns();
+    double event_us = (t1 - t0) / 1e3 / ticks;
+    printf("%d instances, one event each:  %8.1f us per tick (%.1f ns per event, %lu dropped)\n",
+           n, event_us, (double)(t1 - t0) / ticks / n, (unsigned long)runtime.dropped());
+
+    // staggered so that a fifth of the 5 ms timers expire every tick
+    for (int i = 0; i < n; i++)
+        runtime.set(i, IDLE);
+    for (int phase = 0; phase < 5; phase++)
+    {
+        t += ms;
+        runtime.tick(t);
+        for (int i = phase; i < n; i += 5)
+            runtime.dispatch(i, EV_GO);
+    }
+    t0 = MonotonicClock::now_ns();
+    for (int k = 0; k < ticks; k++)
+    {
+        t += ms;
+        runtime.tick(t);
+        for (int i = k % 5; i < n; i += 5)
+            if (runtime.isIn(i, IDLE))
+                runtime.dispatch(i, EV_GO);
+    }
+    t1 = MonotonicClock::now_ns();
+    printf("%d timers expiring per tick:     %8.1f us per tick\n", n / 5, (t1 - t0) / 1e3 / ticks);
+
+    for (int i = 0; i < n; i++)
+        runtime.set(i, OFF);
+    t0 = MonotonicClock::now_ns();
+    for (int k = 0; k < ticks; k++)
+    {
+        t += ms;
+        runtime.tick(t);
+    }
+    t1 = MonotonicClock::now_ns();
+    printf("idle:                            %8.3f us per tick\n", (t1 - t0) / 1e3 / ticks);
+
+    printf("%s in a 1 ms tick\n", event_us < 1000.0 ? "fits" : "does not fit");
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file bench_fsm_trace.cpp
+ *
+ * @brief Time the cost of FSM transition tracing and check dumps under load.
+ *
+ * Times StaticMachine::dispatch() with tracing compiled in, the bare
+ * fsm_trace() call and the TscClock read it contains. Build a second time
+ * with -DBENCH_NO_TRACE for the dispatch cost without tracing. Then snapshots
+ * the rings while another thread traces, and exits with 1 if any record in
+ * the snapshot is torn.
+ *
+ * g++ -std=c++17 -O2 -pthread -I../include bench_fsm_trace.cpp -o bench_fsm_trace
+ * g++ -std=c++17 -O2 -pthread -I../include -DBENCH_NO_TRACE bench_fsm_trace.cpp -o bench_fsm_trace_off
+ * ./bench_fsm_trace
+ */
+
+#ifndef BENCH_NO_TRACE
+#define RD_KITS_FSM_TRACE
+#endif
+#include "static_fsm.h"
+#include "fsm_trace.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+enum
+{
+    IDLE,
+    RUN,
+    NUM_STATES
+};
+
+enum
+{
+    GO,
+    STOP,
+    NUM_EVENTS
+};
+
+struct Robot
+{
+    int x;
+};
+
+constexpr FsmState<Robot> robot_states[] = {{NULL, NULL, 0, 0, 0, 0}, {NULL, NULL, 0, 0, 0, 0}};
+constexpr FsmTransition<Robot> robot_transitions[] = {{IDLE, GO, RUN, NULL, NULL}, {RUN, STOP, IDLE, NULL, NULL}};
+constexpr auto robot_fsm = make_fsm<NUM_EVENTS>(robot_states, robot_transitions);
+
+int main()
+{
+    const int n = 10000000;
+    fsm_trace_init();
+
+    Robot robot = {0};
+    StaticMachine<robot_fsm, SimulatedClock> machine(robot, IDLE);
+    machine.setTraceId(3);
+    uint64_t t0 = MonotonicClock::now_ns();
+    for (int i = 0; i < n; i++)
+        machine.dispatch(i & 1 ? STOP : GO);
+    uint64_t t1 = MonotonicClock::now_ns();
+#ifdef BENCH_NO_TRACE
+    printf("dispatch, tracing off: %6.2f ns per transition\n", (double)(t1 - t0) / n);
+    return 0;
+#else
+    printf("dispatch, tracing on:  %6.2f ns per transition\n", (double)(t1 - t0) / n);
+
+    t0 = MonotonicClock::now_ns();
+    for (int i = 0; i < n; i++)
+        fsm_trace(1, (int16_t)i, (int16_t)~i, 0);
+    t1 = MonotonicClock::now_ns();
+    printf("fsm_trace():           %6.2f ns per record\n", (double)(t1 - t0) / n);
+
+    uint64_t sum = 0;
+    t0 = MonotonicClock::now_ns();
+    for (int i = 0; i < n; i++)
+        sum += TscClock::now_ns();
+    t1 = MonotonicClock::now_ns();
+    printf("TscClock::now_ns():    %6.2f ns per read (%llu)\n", (double)(t1 - t0) / n, (unsigned long long)(sum & 1));
+
+    // every field of a record is derived from its machine id, so a torn one shows
+    std::atomic<bool> stop(false);
+    std::thread writer([&stop]
+                       {
+                           fsm_trace_init();
+                           for (uint32_t i = 0; !stop.load(std::memory_order_relaxed); i++)
+                               fsm_trace(i, (int16_t)i, (int16_t)~i, (int16_t)(i >> 3)); });
+    std::vector<fsm_trace_record_t> records;
+    long torn = 0, checked = 0;
+    for (int k = 0; k < 2000; k++)
+    {
+        fsm_trace_snapshot(records);
+        for (const fsm_trace_record_t &r : records)
+        {
+            if (r.thread != 1)
+                continue;
+            checked++;
+            if (r.from != (int16_t)r.machine || r.to != (int16_t)~r.machine || r.cause != (int16_t)(r.machine >> 3))
+                torn++;
+        }
+    }
+    stop.store(true);
+    writer.join();
+    printf("snapshots under load:  %ld records checked, %ld torn\n", checked, torn);
+    return torn == 0 ? 0 : 1;
+#endif
+}
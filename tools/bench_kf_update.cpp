@@ -0,0 +1,52 @@
+/**
+ * @file bench_kf_update.cpp
+ *
+ * @brief Time one KalmanFilter update per KalmanUpdateMethod.
+ *
+ * 6-state / 3-measurement constant-velocity model, fixed sizes.
+ *
+ * g++ -std=c++17 -O2 -I../include -I/usr/include/eigen3 bench_kf_update.cpp -o bench_kf_update
+ * ./bench_kf_update [updates]
+ */
+
+#include "standard_kf.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv)
+{
+    const long iters = argc > 1 ? atol(argv[1]) : 1000000;
+    const double dt = 0.01;
+    Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Identity();
+    Eigen::Matrix<double, 3, 6> C = Eigen::Matrix<double, 3, 6>::Zero();
+    for (int i = 0; i < 3; i++)
+    {
+        A(i, i + 3) = dt;
+        C(i, i) = 1.0;
+    }
+    Eigen::Matrix<double, 6, 6> Q = Eigen::Matrix<double, 6, 6>::Identity() * 1e-4;
+    Eigen::Matrix<double, 6, 6> P = Eigen::Matrix<double, 6, 6>::Identity();
+    Eigen::Matrix3d R = Eigen::Matrix3d::Identity() * 0.05;
+
+    const char *names[] = {"inverse", "ldlt", "joseph", "sequential"};
+    for (int method = KF_UPDATE_INVERSE; method <= KF_UPDATE_SEQUENTIAL; method++)
+    {
+        KalmanFilter<6, 3> kf(dt, A, C, Q, R, P, (KalmanUpdateMethod)method);
+        kf.init();
+        Eigen::Matrix<double, 3, 1> y;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (long i = 0; i < iters; i++)
+        {
+            y << i * dt, 2.0 * i * dt, -i * dt;
+            kf.update(y);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+
+        printf("%-10s %7.1f ns/update  (x0 %.3f)\n", names[method],
+               std::chrono::duration<double, std::nano>(t1 - t0).count() / iters, kf.state()(0));
+    }
+    return 0;
+}
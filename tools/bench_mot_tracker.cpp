@@ -0,0 +1,158 @@
+/**
+ * @file bench_mot_tracker.cpp
+ *
+ * @brief Time MotTracker on a synthetic scene and check that threads do not change the result.
+ *
+ * Targets move at constant velocity with random acceleration on a 200 x 200 m
+ * field at 30 Hz for 300 frames. Each target is detected with probability
+ * 0.95 and 0.1 m noise, and 50 clutter points are added per frame. For 600
+ * and 2000 targets, prints the p50 and p99 update() time after the first
+ * second, the confirmed tracks at the end and the id switch rate, once on
+ * the calling thread and once with the given number of threads. Exits with 1
+ * if the two runs assign any detection differently.
+ *
+ * g++ -std=c++17 -O2 -pthread -I../include -I/usr/include/eigen3 bench_mot_tracker.cpp -o bench_mot_tracker
+ * ./bench_mot_tracker [threads]
+ */
+
+#include "mot_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+typedef MotTracker<4, 2> Tracker;
+typedef std::vector<Tracker::MeasurementVector, Eigen::aligned_allocator<Tracker::MeasurementVector>> DetectionVector;
+
+static void cv_transition(double dt, Tracker::StateMatrix &A, Tracker::StateMatrix &Q)
+{
+    const double q = 1.0;
+    A.setIdentity();
+    A(0, 2) = A(1, 3) = dt;
+    Q.setZero();
+    Q(0, 0) = Q(1, 1) = q * dt * dt * dt / 3;
+    Q(0, 2) = Q(2, 0) = Q(1, 3) = Q(3, 1) = q * dt * dt / 2;
+    Q(2, 2) = Q(3, 3) = q * dt;
+}
+
+typedef struct
+{
+    double p50_us, p99_us;
+    int confirmed;
+    double switch_rate; // id changes per target detection
+    std::vector<int> assignments;
+} scene_result_t;
+
+static scene_result_t run_scene(int targets, int threads)
+{
+    const int frames = 300, warmup = 30, clutter = 50;
+    const double dt = 1.0 / 30, pd = 0.95, sigma = 0.1;
+
+    Tracker::StateMatrix A = Tracker::StateMatrix::Identity(), Q = Tracker::StateMatrix::Zero(), P0 = Tracker::StateMatrix::Identity();
+    P0(2, 2) = P0(3, 3) = 4.0;
+    Tracker::OutputMatrix C = Tracker::OutputMatrix::Zero();
+    C(0, 0) = C(1, 1) = 1.0;
+    Tracker::MeasurementMatrix R = Tracker::MeasurementMatrix::Identity() * sigma * sigma;
+    mot_tracker_config_t config = mot_tracker_default_config();
+    config.threads = threads;
+    Tracker tracker(2 * targets + 4 * clutter, A, C, Q, R, P0, cv_transition, config);
+
+    // the same scene for every run
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d>> truth(targets);
+    for (Eigen::Vector4d &x : truth)
+        x << uniform(gen) * 200, uniform(gen) * 200, normal(gen) * 1.5, normal(gen) * 1.5;
+
+    scene_result_t result;
+    DetectionVector detections;
+    std::vector<int> source, last_id(targets, -1);
+    std::vector<double> times;
+    long switches = 0, matched = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        detections.clear();
+        source.clear();
+        for (int i = 0; i < targets; i++)
+        {
+            truth[i](0) += truth[i](2) * dt;
+            truth[i](1) += truth[i](3) * dt;
+            truth[i](2) += normal(gen) * 0.1;
+            truth[i](3) += normal(gen) * 0.1;
+            if (uniform(gen) < pd)
+            {
+                detections.push_back(Tracker::MeasurementVector(truth[i](0) + normal(gen) * sigma, truth[i](1) + normal(gen) * sigma));
+                source.push_back(i);
+            }
+        }
+        for (int c = 0; c < clutter; c++)
+        {
+            detections.push_back(Tracker::MeasurementVector(uniform(gen) * 200, uniform(gen) * 200));
+            source.push_back(-1);
+        }
+        for (size_t i = detections.size() - 1; i > 0; i--)
+        {
+            size_t j = gen() % (i + 1);
+            std::swap(detections[i], detections[j]);
+            std::swap(source[i], source[j]);
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        tracker.update(f * dt, detections.data(), (int)detections.size());
+        auto t1 = std::chrono::steady_clock::now();
+        if (f >= warmup)
+            times.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+        const std::vector<int> &assignment = tracker.getAssignment();
+        result.assignments.insert(result.assignments.end(), assignment.begin(), assignment.end());
+        for (size_t d = 0; d < detections.size(); d++)
+        {
+            int i = source[d];
+            if (i < 0)
+                continue;
+            if (f >= warmup)
+            {
+                matched++;
+                switches += last_id[i] >= 0 && last_id[i] != assignment[d];
+            }
+            last_id[i] = assignment[d];
+        }
+    }
+
+    std::sort(times.begin(), times.end());
+    result.p50_us = times[times.size() / 2];
+    result.p99_us = times[(size_t)(times.size() * 0.99)];
+    result.confirmed = 0;
+    for (int slot : tracker.getActive())
+        result.confirmed += tracker.getTrack(slot).state == TRACK_CONFIRMED;
+    result.switch_rate = (double)switches / matched;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const int threads = argc > 1 ? atoi(argv[1]) : 4;
+    const int target_counts[] = {600, 2000};
+    int failed = 0;
+
+    printf("%8s %8s %10s %10s %10s %12s\n", "targets", "threads", "p50 us", "p99 us", "confirmed", "switch rate");
+    for (int targets : target_counts)
+    {
+        scene_result_t serial = run_scene(targets, 1);
+        scene_result_t parallel = run_scene(targets, threads);
+        const scene_result_t *runs[] = {&serial, &parallel};
+        for (int k = 0; k < 2; k++)
+            printf("%8d %8d %10.0f %10.0f %10d %12.2e\n", targets, k == 0 ? 1 : threads,
+                   runs[k]->p50_us, runs[k]->p99_us, runs[k]->confirmed, runs[k]->switch_rate);
+        if (serial.assignments != parallel.assignments)
+        {
+            printf("%d targets: %d threads assign differently from 1\n", targets, threads);
+            failed = 1;
+        }
+    }
+    return failed;
+}
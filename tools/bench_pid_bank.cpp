@@ -0,0 +1,85 @@
+/**
+ * @file bench_pid_bank.cpp
+ *
+ * @brief Compare PIDBank with one BasicPID per channel, for equal outputs and for speed.
+ *
+ * The comparison runs both on SimulatedClock, so the outputs match exactly.
+ * The timing also includes the default PID, which reads MonotonicClock on
+ * every calculate(). Build with -O3 -march=native to let the compiler
+ * vectorize PIDBank::calculate.
+ *
+ * g++ -std=c++17 -O3 -march=native -I../include bench_pid_bank.cpp -o bench_pid_bank
+ * ./bench_pid_bank [channels]
+ */
+
+#include "pid.h"
+#include "pid_bank.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    const int n = argc > 1 ? atoi(argv[1]) : 24;
+    SimulatedClock::set_ns(1000000000ULL);
+
+    PIDBank bank(n);
+    std::vector<BasicPID<SimulatedClock>> pids;
+    std::vector<PID> real_pids;
+    std::vector<float> limit(n), error(n), output(n);
+    for (int i = 0; i < n; i++)
+    {
+        float Kp = 1.0f + i * 0.1f;
+        limit[i] = 10.0f + i;
+        bank.setGains(i, Kp, 0.01f, 0.5f);
+        bank.setLimit(i, limit[i]);
+        pids.emplace_back(Kp, 0.01f, 0.5f);
+        real_pids.emplace_back(Kp, 0.01f, 0.5f);
+    }
+
+    double max_diff = 0.0;
+    for (int step = 0; step < 1000; step++)
+    {
+        SimulatedClock::advance_ns(1000000);
+        for (int i = 0; i < n; i++)
+            error[i] = 20.0f * sinf(step * 0.01f + i);
+        bank.calculate(error.data(), output.data(), SimulatedClock::now_ns());
+        for (int i = 0; i < n; i++)
+            max_diff = fmax(max_diff, fabs(output[i] - pids[i].calculate(error[i], limit[i])));
+    }
+    printf("%d channels, max output difference %g\n", n, max_diff);
+
+    const int iters = 200000;
+    uint64_t t_ns = SimulatedClock::now_ns();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int step = 0; step < iters; step++)
+    {
+        error[step % n] += 1e-3f;
+        bank.calculate(error.data(), output.data(), t_ns);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    float sum = 0.0f;
+    for (int step = 0; step < iters; step++)
+    {
+        error[step % n] += 1e-3f;
+        for (int i = 0; i < n; i++)
+            sum += pids[i].calculate(error[i], limit[i]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    for (int step = 0; step < iters; step++)
+    {
+        error[step % n] += 1e-3f;
+        for (int i = 0; i < n; i++)
+            sum += real_pids[i].calculate(error[i], limit[i]);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    printf("PIDBank::calculate            %8.1f ns per cycle\n", std::chrono::duration<double, std::nano>(t1 - t0).count() / iters);
+    printf("%d x BasicPID<SimulatedClock> %8.1f ns per cycle\n", n, std::chrono::duration<double, std::nano>(t2 - t1).count() / iters);
+    printf("%d x PID (MonotonicClock)     %8.1f ns per cycle  (%g %g)\n", n,
+           std::chrono::duration<double, std::nano>(t3 - t2).count() / iters, output[0], sum);
+    return max_diff == 0.0 ? 0 : 1;
+}
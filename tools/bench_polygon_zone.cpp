@@ -0,0 +1,112 @@
+/**
+ * @file bench_polygon_zone.cpp
+ *
+ * @brief Time "which zone contains this point" with ZoneIndex against brute force.
+ *
+ * Zones are random 12-vertex star polygons on a 12 x 8 m field, 10k query
+ * points per frame. For 10, 50 and 200 zones, prints ns per point for:
+ * - ZoneIndex::find() before build(), a linear scan over the zones;
+ * - ZoneIndex::find() on the grid;
+ * - a triangle fan per zone through check_point_is_inside_triangle_batch().
+ * Exits with 1 if the grid and the linear scan ever disagree.
+ *
+ * g++ -std=c++17 -O2 -I../include bench_polygon_zone.cpp -o bench_polygon_zone
+ * ./bench_polygon_zone
+ */
+
+#include "extended_math.h"
+#include "polygon_zone.h"
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+int main()
+{
+    const int sides = 12;
+    const size_t n = 10000;
+    const int reps = 20;
+    const int zone_counts[] = {10, 50, 200};
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int failed = 0;
+
+    printf("%6s %8s %8s %10s %10s\n", "zones", "linear", "grid", "build ms", "tri fan");
+    for (int num_zones : zone_counts)
+    {
+        ZoneIndex index;
+        std::vector<std::vector<point2d_t>> polygons;
+        std::vector<point2d_t> centres;
+        for (int k = 0; k < num_zones; k++)
+        {
+            point2d_t c = {uniform(gen) * 12.0f, uniform(gen) * 8.0f};
+            float r = 0.3f + uniform(gen) * 1.2f;
+            std::vector<point2d_t> v(sides);
+            for (int i = 0; i < sides; i++)
+            {
+                float a = 2.0f * (float)M_PI * i / sides, rr = r * (0.5f + 0.5f * uniform(gen));
+                v[i] = {c.x + rr * cosf(a), c.y + rr * sinf(a)};
+            }
+            index.add(v.data(), sides);
+            polygons.push_back(v);
+            centres.push_back(c);
+        }
+
+        // random points, plus some vertices to exercise the boundary
+        std::vector<point2d_t> points(n);
+        for (point2d_t &p : points)
+            p = {uniform(gen) * 12.0f, uniform(gen) * 8.0f};
+        for (int k = 0; k < num_zones && k < 100; k++)
+            points[k] = polygons[k][k % sides];
+
+        std::vector<int> linear(n), grid(n), fan(n);
+        auto t0 = bench_clock::now();
+        for (int r = 0; r < reps; r++)
+            index.find(points.data(), n, linear.data());
+        auto t1 = bench_clock::now();
+        index.build();
+        auto t2 = bench_clock::now();
+        for (int r = 0; r < reps; r++)
+            index.find(points.data(), n, grid.data());
+        auto t3 = bench_clock::now();
+
+        // the lowest zone id wins, as in ZoneIndex::find()
+        std::vector<uint8_t> mask(n);
+        for (int r = 0; r < reps; r++)
+        {
+            std::fill(fan.begin(), fan.end(), -1);
+            for (int k = num_zones - 1; k >= 0; k--)
+            {
+                const std::vector<point2d_t> &v = polygons[k];
+                for (int j = 0; j < sides; j++)
+                {
+                    const point2d_t &a = v[j], &b = v[(j + 1) % sides];
+                    check_point_is_inside_triangle_batch(points.data(), n, centres[k].x, centres[k].y, a.x, a.y, b.x, b.y, mask.data());
+                    for (size_t i = 0; i < n; i++)
+                        if (mask[i])
+                            fan[i] = k;
+                }
+            }
+        }
+        auto t4 = bench_clock::now();
+
+        auto ns = [&](bench_clock::time_point a, bench_clock::time_point b)
+        { return std::chrono::duration<double, std::nano>(b - a).count() / reps / n; };
+        size_t mismatch = 0;
+        for (size_t i = 0; i < n; i++)
+            mismatch += linear[i] != grid[i];
+        printf("%6d %8.1f %8.1f %10.2f %10.1f\n", num_zones, ns(t0, t1), ns(t2, t3),
+               std::chrono::duration<double, std::milli>(t2 - t1).count(), ns(t3, t4));
+        if (mismatch)
+        {
+            printf("grid and linear scan disagree on %zu points\n", mismatch);
+            failed = 1;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file fsm_trace_decode.cpp
+ *
+ * @brief Decode a dump written by fsm_trace_dump() to text or CSV.
+ *
+ * g++ -std=c++17 -I../include fsm_trace_decode.cpp -o fsm_trace_decode
+ * ./fsm_trace_decode fsm.trace [--csv] > fsm.txt
+ */
+
+#include "fsm_trace.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <dump file> [--csv]\n", argv[0]);
+        return 1;
+    }
+
+    bool csv = argc > 2 && strcmp(argv[2], "--csv") == 0;
+    if (fsm_trace_decode(argv[1], stdout, csv) < 0)
+    {
+        fprintf(stderr, "%s: not a valid fsm trace dump\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file kf_alloc_check.cpp
+ *
+ * @brief Check that a fixed-size KalmanFilter does not allocate while filtering.
+ *
+ * Eigen's own allocations are caught with EIGEN_RUNTIME_NO_MALLOC, any other
+ * heap use by the global operator new. Exits with 1 when update(), predict()
+ * or correct() allocated, for every update method.
+ *
+ * g++ -std=c++17 -O2 -I../include -I/usr/include/eigen3 kf_alloc_check.cpp -o kf_alloc_check
+ * ./kf_alloc_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+static bool alloc_armed = false;
+static long alloc_count = 0;
+
+// count instead of abort, so the check also works with NDEBUG
+#define EIGEN_RUNTIME_NO_MALLOC
+#define eigen_assert(x)      \
+    do                       \
+    {                        \
+        if (!(x))            \
+            alloc_count++;   \
+    } while (0)
+
+#include "standard_kf.h"
+
+void *operator new(size_t size)
+{
+    if (alloc_armed)
+        alloc_count++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static void arm(bool on)
+{
+    alloc_armed = on;
+    Eigen::internal::set_is_malloc_allowed(!on);
+}
+
+int main()
+{
+    const double dt = 0.01;
+    Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Identity();
+    Eigen::Matrix<double, 3, 6> C = Eigen::Matrix<double, 3, 6>::Zero();
+    for (int i = 0; i < 3; i++)
+    {
+        A(i, i + 3) = dt;
+        C(i, i) = 1.0;
+    }
+    Eigen::Matrix<double, 6, 6> Q = Eigen::Matrix<double, 6, 6>::Identity() * 1e-4;
+    Eigen::Matrix<double, 6, 6> P = Eigen::Matrix<double, 6, 6>::Identity();
+    Eigen::Matrix3d R = Eigen::Matrix3d::Identity() * 0.05;
+
+    KalmanSensor<6, 1> range;
+    range.C = Eigen::Matrix<double, 1, 6>::Zero();
+    range.C(0, 2) = 1.0;
+    range.R << 0.01;
+
+    const char *names[] = {"inverse", "ldlt", "joseph", "sequential"};
+    int failed = 0;
+    for (int method = KF_UPDATE_INVERSE; method <= KF_UPDATE_SEQUENTIAL; method++)
+    {
+        KalmanFilter<6, 3> kf(dt, A, C, Q, R, P, (KalmanUpdateMethod)method);
+        kf.init();
+        Eigen::Matrix<double, 3, 1> y;
+        Eigen::Matrix<double, 1, 1> z;
+
+        alloc_count = 0;
+        arm(true);
+        for (int i = 0; i < 1000; i++)
+        {
+            double t = i * dt;
+            y << t, 2.0 * t, -t;
+            kf.update(y);
+            kf.correct(y, t + 0.5 * dt);
+            z << -t;
+            kf.correct(z, t + 0.7 * dt, range);
+            kf.predict(t + 0.9 * dt, [](double step, Eigen::Matrix<double, 6, 6> &A, Eigen::Matrix<double, 6, 6> &) {
+                for (int k = 0; k < 3; k++)
+                    A(k, k + 3) = step;
+            });
+        }
+        arm(false);
+
+        printf("%-10s %ld allocations\n", names[method], alloc_count);
+        if (alloc_count != 0)
+            failed = 1;
+    }
+    return failed;
+}
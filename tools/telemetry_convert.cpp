@@ -0,0 +1,29 @@
+/**
+ * @file telemetry_convert.cpp
+ *
+ * @brief Convert a telemetry log written by TelemetryLog to CSV or raw columns.
+ *
+ * g++ -std=c++17 -I../include telemetry_convert.cpp -o telemetry_convert
+ * ./telemetry_convert run.tlm out_dir [--columns]
+ */
+
+#include "telemetry.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <log file> <output dir> [--columns]\n", argv[0]);
+        return 1;
+    }
+
+    bool columns = argc > 3 && strcmp(argv[3], "--columns") == 0;
+    long n = columns ? telemetry_to_columns(argv[1], argv[2]) : telemetry_to_csv(argv[1], argv[2]);
+    if (n < 0)
+    {
+        fprintf(stderr, "%s: cannot convert to %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    fprintf(stderr, "%ld records\n", n);
+    return 0;
+}